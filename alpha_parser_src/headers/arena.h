@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_FIRST_CHUNK 4096
+#define ARENA_MAX_CHUNK (1 << 20)
+
+typedef struct arena_chunk arena_chunk;
+
+/* Bump allocator for objects that live until the end of a compilation phase */
+typedef struct Arena {
+    arena_chunk *head;      /* newest chunk, allocations come from here */
+    size_t nextSize;        /* doubles up to ARENA_MAX_CHUNK */
+    size_t used;            /* bytes handed out */
+    size_t reserved;        /* bytes held in chunks */
+    unsigned chunks;
+} Arena;
+
+#define ARENA_INIT { NULL, ARENA_FIRST_CHUNK, 0, 0, 0 }
+
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strdup(Arena *arena, const char *s);
+void arena_free(Arena *arena);
+
+#endif
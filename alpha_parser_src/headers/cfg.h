@@ -0,0 +1,139 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include "quad.h"
+#include <limits.h>
+
+#define CFG_INITIAL_SIZE 8
+
+#define CFG_NONE UINT_MAX           /* no block */
+#define CFG_EXIT (UINT_MAX - 1)     /* the end of the program, label curr_quad */
+
+/*
+ * A quad inside a block. Branch labels hold block numbers of the same
+ * function (or CFG_EXIT) while the program is in this form. In SSA form
+ * value[] names the SSA value of result, arg1 and arg2; 0 marks operands
+ * that are not SSA variables.
+ */
+typedef struct cfg_instr {
+    Quad quad;
+    unsigned value[3];
+    int dead;                       /* dropped when lowered */
+} cfg_instr;
+
+enum { CFG_RESULT, CFG_ARG1, CFG_ARG2 };
+
+typedef struct cfg_edge {
+    unsigned block;
+    int branch;                     /* taken branch rather than fallthrough */
+} cfg_edge;
+
+typedef struct cfg_phi {
+    unsigned var;
+    unsigned value;                 /* defined by the phi */
+    unsigned *args;                 /* one value per entry of the block's preds */
+    int dead;
+    int numeric;                    /* only numbers reach it, so its copies get Quad.numeric */
+} cfg_phi;
+
+typedef struct cfg_block {
+    cfg_instr *instrs;
+    unsigned count, size;
+
+    unsigned fallthrough;           /* reached past the last instruction: a block, CFG_EXIT or CFG_NONE */
+    unsigned target;                /* where the closing branch goes: a block, CFG_EXIT or CFG_NONE */
+
+    cfg_edge *preds;                /* one entry per incoming edge */
+    unsigned predCount, predSize;
+
+    cfg_phi *phis;
+    unsigned phiCount, phiSize;
+
+    unsigned rpo;                   /* reverse postorder number, CFG_NONE if unreachable */
+    unsigned idom;                  /* CFG_NONE for the entry and unreachable blocks */
+    unsigned domPre, domPost;       /* dominator tree interval */
+    unsigned *frontier;
+    unsigned frontierCount, frontierSize;
+
+    unsigned nextFunc, nextBlock;   /* the block laid out after this one, nextFunc CFG_NONE at the end */
+} cfg_block;
+
+/* An SSA variable: a local, a formal or a temporary of one function only */
+typedef struct ssa_var {
+    SymTableEntry *sym;
+    unsigned entry;                 /* value it holds when the function is entered */
+    int global;                     /* live across blocks, so phis are placed for it */
+} ssa_var;
+
+typedef struct ssa_value {
+    unsigned var;
+    unsigned block;                 /* where it is defined */
+    int pos;                        /* instruction defining it, -1 for a phi, -2 for the entry value */
+    unsigned uses;
+    SymTableEntry *home;            /* variable holding it after lowering */
+} ssa_value;
+
+/* The top-level code or one function body, without the functions nested in it */
+typedef struct cfg_function {
+    SymTableEntry *func;            /* NULL for the top-level code */
+    unsigned scope;                 /* where fresh temporaries are declared */
+
+    cfg_block *blocks;              /* block 0 is the entry */
+    unsigned blockCount, blockSize;
+
+    unsigned *rpoOrder;             /* reachable blocks in reverse postorder */
+    unsigned reachable;
+
+    ssa_var *vars;
+    unsigned varCount, varSize;
+    ssa_value *values;              /* value 0 is unused */
+    unsigned valueCount, valueSize;
+    int inSSA;
+} cfg_function;
+
+typedef struct cfg_program {
+    cfg_function *funcs;            /* funcs[0] is the top-level code */
+    unsigned funcCount;
+    unsigned headFunc, headBlock;   /* first block laid out */
+} cfg_program;
+
+/*
+ * Splits the quads into functions and basic blocks. Returns NULL, leaving
+ * the quads alone, when a branch has no valid target (the parse reported
+ * an error) or the program is empty.
+ */
+cfg_program *cfg_build(void);
+
+/* Replaces the quads with the blocks in layout order; jumps are added where a fallthrough moved */
+void cfg_lower(cfg_program *p);
+void cfg_free(cfg_program *p);
+
+/* Reverse postorder, immediate dominators (Cooper, Harvey, Kennedy) and dominance frontiers */
+void cfg_dominators(cfg_function *f);
+int cfg_dominates(cfg_function *f, unsigned a, unsigned b);
+
+/* Dominator tree children of b, in reverse postorder: children[start[b]] .. children[start[b + 1] - 1] */
+unsigned *cfg_dom_children(cfg_function *f, unsigned **start);
+
+/* An empty block, not laid out and with no edges */
+unsigned cfg_new_block(cfg_function *f);
+
+/* Rebuilds every predecessor list of f from the fallthroughs and targets; not for SSA form */
+void cfg_link_preds(cfg_function *f);
+
+/* Successors of a block inside its function; returns how many */
+unsigned cfg_successors(cfg_block *b, unsigned succ[2]);
+
+/* Puts an empty block on the edge pred -> b and returns it; lays it out after pred */
+unsigned cfg_split_edge(cfg_program *p, unsigned func, unsigned pred, int branch);
+
+cfg_instr *cfg_insert(cfg_function *f, unsigned block, unsigned pos, Quad *quad);
+
+/* The operands of an instruction, CFG_RESULT to CFG_ARG2; only a result that is written is a def */
+int cfg_defines(cfg_instr *instr, int operand);
+Expr **cfg_operand(cfg_instr *instr, int operand);
+
+void *cfg_calloc(size_t count, size_t size);
+void *cfg_reserve(void *array, unsigned used, unsigned *size, size_t elem);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef COMPILE_STATS_H
+#define COMPILE_STATS_H
+
+#include <stdio.h>
+
+typedef enum compile_phase {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_GENERATE,
+    PHASE_WRITE,
+    PHASE_COUNT
+} compile_phase;
+
+typedef struct phase_stat {
+    double seconds;
+    long peakRssKb;     /* process high-water mark when the phase ended, 0 if it never ran */
+} phase_stat;
+
+/* Sections of the .abc file, in the order write_binary_file emits them */
+typedef enum abc_section {
+    ABC_HEADER,
+    ABC_STRINGS,
+    ABC_NUMBERS,
+    ABC_LIBFUNCS,
+    ABC_USERFUNCS,
+    ABC_CODE,
+    ABC_SECTION_COUNT
+} abc_section;
+
+extern phase_stat phaseStats[PHASE_COUNT];
+extern char *phaseNames[PHASE_COUNT];
+
+extern unsigned long newtempCalls;      /* every newtemp() */
+extern unsigned long newtempSymbols;    /* newtemp() calls that declared a new symbol */
+extern unsigned long foldedExprs;       /* operations evaluated at compile time */
+extern long abcSectionBytes[ABC_SECTION_COUNT];
+
+void phase_begin(void);
+void phase_end(compile_phase phase);
+
+void print_phase_times(FILE *out, char *input);
+void print_compile_stats(FILE *out, int json);
+
+#endif
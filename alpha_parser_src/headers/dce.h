@@ -0,0 +1,14 @@
+#ifndef DCE_H
+#define DCE_H
+
+#include "cfg.h"
+
+/*
+ * Drops copies and phis whose value is never read, e.g. the temporary
+ * every assignment expression yields. Copies to or from formals stay, as
+ * the VM reports formals the caller did not pass; copying an undefined
+ * variable is only a warning, so a dead copy of one goes silently.
+ */
+unsigned long eliminate_dead_code(cfg_program *p, unsigned func);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef GVN_H
+#define GVN_H
+
+#include "cfg.h"
+
+#define GVN_INITIAL_BUCKETS 64
+
+/*
+ * Global value numbering over the dominator tree, with copy and constant
+ * propagation. Uses of a copy read its source instead, arithmetic on
+ * constants is folded and a computation already available in a
+ * dominating block is reused. Table reads and anything reading a
+ * variable outside SSA form are only reused while no call, table write
+ * or def of such a variable can have come in between, which is tracked
+ * within extended basic blocks. The copies left unread go in dce.
+ */
+unsigned long number_values(cfg_program *p, unsigned func);
+
+#endif
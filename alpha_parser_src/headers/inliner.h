@@ -0,0 +1,22 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include "cfg.h"
+
+#define INLINE_MAX_QUADS 24         /* callee size, without funcstart and funcend */
+#define INLINE_MAX_VARS 32          /* formals, locals and temporaries of the callee */
+
+/*
+ * Replaces direct calls to small named functions with a copy of their
+ * body. A callee qualifies when it calls no user function, so it cannot
+ * recurse, does not look at its arguments through totalarguments or
+ * argument, and never reads a local before assigning it, since a frame
+ * starts out undefined while the caller's does not. Calls passing fewer
+ * arguments than the formals the callee reads stay calls. The formals,
+ * locals and temporaries of each copy become fresh temporaries of the
+ * caller. ret and getretval stay, so the return value travels as before.
+ * Returns how many calls were replaced.
+ */
+unsigned long inline_calls(void);
+
+#endif
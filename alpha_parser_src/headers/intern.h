@@ -0,0 +1,16 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+#define INTERN_INITIAL_SLOTS 1024
+
+/* Equal strings share one copy that lives until intern_free; never free or modify it */
+char *intern(const char *s);
+char *intern_len(const char *s, size_t len);
+void intern_free(void);
+
+extern unsigned long internLookups;     /* intern() calls */
+extern unsigned long internStrings;     /* distinct strings stored */
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef LICM_H
+#define LICM_H
+
+#include "cfg.h"
+
+/*
+ * Loop-invariant code motion. Natural loops are found from the back
+ * edges of the dominator tree and handled innermost first, so that what
+ * leaves an inner loop can leave the enclosing ones too. Arithmetic on
+ * operands the loop never changes goes to a preheader, as do invariant
+ * reads of tables when the loop has no table writes and no calls. The VM
+ * stops on a failed operation, so only what runs whenever the loop is
+ * entered, or what cannot fail, is moved.
+ */
+unsigned long hoist_invariants(cfg_program *p, unsigned func);
+
+#endif
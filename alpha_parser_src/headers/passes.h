@@ -0,0 +1,32 @@
+#ifndef PASSES_H
+#define PASSES_H
+
+#include "cfg.h"
+
+typedef enum pass_kind {
+    QUAD_PASS,      /* works on the quad array */
+    SSA_PASS        /* works on one function at a time, in SSA form */
+} pass_kind;
+
+typedef struct opt_pass {
+    char *name;
+    int level;                                              /* lowest -O level that runs it */
+    pass_kind kind;
+    unsigned long (*run)(void);                             /* QUAD_PASS */
+    unsigned long (*runFunction)(cfg_program *p, unsigned func);    /* SSA_PASS */
+    unsigned long changes;                                  /* what the pass reports it did */
+    int ran;
+} opt_pass;
+
+extern int optLevel;                    /* -O0, -O1 (default) or -O2 */
+extern opt_pass optPasses[];
+extern unsigned optPassCount;
+
+/*
+ * Runs the passes of the current level in table order, between parsing
+ * and generate. Consecutive SSA passes share one trip into SSA form and
+ * back; at -O0 nothing runs and nothing is folded while parsing.
+ */
+void run_passes(void);
+
+#endif
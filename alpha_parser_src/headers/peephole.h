@@ -0,0 +1,23 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#define PEEPHOLE_MAX_HOPS 32    /* longest jump chain followed when threading */
+
+/* A run of quads entered only at first and left only after last */
+typedef struct basic_block {
+    unsigned first;
+    unsigned last;
+    int reachable;
+} basic_block;
+
+/*
+ * Cleans up the jumps left by backpatching: threads jumps to jumps,
+ * deletes jumps to the next quad and blocks nothing can reach, then
+ * renumbers the quads and their labels. Runs between yyparse and generate.
+ */
+void peephole(void);
+
+extern unsigned long jumpsThreaded;
+extern unsigned long quadsRemoved;
+
+#endif
@@ -2,6 +2,7 @@
 #define QUAD_H
 
 #include "symtable.h"
+#include "arena.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -60,6 +61,7 @@ typedef struct Quad {
     unsigned label;
     unsigned line;
     unsigned taddress;
+    unsigned char numeric;      /* every operand read is a number; set at -O2 by infer_types */
 } Quad;
 
 typedef struct stmt {
@@ -72,7 +74,8 @@ void make_stmt(stmt_t **s);
 
 typedef struct forstmt {
     unsigned test;
-    unsigned enter;
+    unsigned enter;     /* true exits of the condition, patched to the body */
+    unsigned exit;      /* false exits, patched past the loop */
 } forstmt_t;
 
 typedef struct FunctCont {
@@ -88,6 +91,7 @@ void resetTemp(void);
 char *newtempname(void);
 SymTableEntry *newtemp();
 void initQuads(void);
+void freeQuads(void);
 void printQuads(void);
 
 Expr *newExpr(Expr_t type);
@@ -101,9 +105,19 @@ const char *getOpcodeName(iopcode op);
 const char *getExprType(Expr_t type);
 const char *exprToString(Expr *e);
 int isArithExpr(Expr *e);
+int isBranch(iopcode op);
+int writesResult(iopcode op);
+SymTableEntry *operandVariable(Expr *e);
+int const_tobool(Expr *e, unsigned char *value);
+
+Expr *fold_arith(iopcode op, Expr *e1, Expr *e2);
+Expr *fold_relop(iopcode op, Expr *e1, Expr *e2);
+Expr *fold_libcall(Expr *func, Expr *elist);
 
 extern unsigned int temp_counter;
 
+extern Arena irArena;       /* Exprs, statements and temp names; freed by freeQuads */
+
 extern Quad *quads;
 extern unsigned quadsSize;
 extern unsigned curr_quad;
@@ -20,6 +20,7 @@ extern int localOffset;
 extern void *scopeOffsetStack;
 
 void initOffsetManagement();
+void freeOffsetManagement();
 int currscopespace();
 int currscopeoffset();
 void inccurrscopeoffset();
@@ -39,7 +40,5 @@ void exitFunctionDefinition();
 SymbolType determineVariableType();
 SymTableEntry *declareVariable(SymTable *symTable, const char *name,
                                unsigned int scope, unsigned int line);
-void enterBlock();
-void exitBlock(int isFunctionBlock);
 
 #endif
\ No newline at end of file
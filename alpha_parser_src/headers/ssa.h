@@ -0,0 +1,30 @@
+#ifndef SSA_H
+#define SSA_H
+
+#include "cfg.h"
+
+/*
+ * SSA form over the control flow graph. The SSA variables of a function
+ * are its formals, locals and temporaries, and the temporaries of the
+ * top-level code, as long as no other function names them; named globals
+ * stay as they are since any call may change them. Phis are placed on the
+ * iterated dominance frontier of the defs, for variables live across
+ * blocks only.
+ */
+void ssa_build(cfg_program *p);
+
+/*
+ * Back to plain variables. Each SSA value gets a home: the variable it
+ * came from when no other value of that variable is live at its def, a
+ * fresh temporary otherwise. Phis whose arguments do not share their home
+ * become copies on the incoming edges, splitting the edges that need it.
+ */
+void ssa_destroy(cfg_program *p);
+
+unsigned ssa_new_value(cfg_function *f, unsigned var, unsigned block, int pos);
+
+/* A temporary in the function's frame, declared after parsing */
+SymTableEntry *ssa_fresh_temp(cfg_function *f);
+Expr *ssa_var_expr(SymTableEntry *sym);
+
+#endif
@@ -1,8 +1,8 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
 
-#define HASH_SIZE 509
-#define MAX_SCOPE 100
+#define SYMTABLE_INITIAL_BUCKETS 512
+#define SYMTABLE_INITIAL_SCOPES 16
 
 typedef enum SymbolType {
     GLOBAL_VAR,
@@ -21,27 +21,29 @@ typedef struct SymTableEntry {
     unsigned space;
     unsigned localCount;
     unsigned taddress;
+    unsigned tempId;        /* N + 1 for newtemp's _tN, 0 for named symbols */
     int isActive;
     SymbolType type;
 
-    struct SymTableEntry *nextInScope;
-    struct SymTableEntry *nextLink;
+    struct SymTableEntry *nextInScope;  /* every entry of the scope, ordered by line */
+    struct SymTableEntry *nextLink;     /* hash chain, active entries only */
+    struct SymTableEntry *nextActive;   /* active entries of the same scope */
 
 } SymTableEntry;
 
-typedef struct Binding {
-
-    char *key;
-    SymTableEntry *entry;
-    struct Binding *next;
+typedef struct SymTable {
 
-} Binding;
+    unsigned int length;                /* entries ever inserted */
+    unsigned int activeCount;           /* entries reachable through the buckets */
 
-typedef struct SymTable {
+    unsigned int bucketCount;           /* power of two, grows with activeCount */
+    SymTableEntry **buckets;
 
-    unsigned int length;
-    Binding *buckets[HASH_SIZE];
-    SymTableEntry *scopeLists[MAX_SCOPE];
+    unsigned int scopeCount;            /* grows with the deepest scope seen */
+    SymTableEntry **scopeLists;
+    SymTableEntry **scopeTails;
+    SymTableEntry **scopeCursors;       /* last entry inserted before the tail */
+    SymTableEntry **scopeActive;
 
 } SymTable;
 
@@ -17,6 +17,13 @@ typedef enum vmopcode {
     jgt_v,          jump_v,         call_v, 
     pusharg_v,      funcenter_v,    funcexit_v,
     newtable_v,     tablegetelem_v, tablesetelem_v,
+    tailcall_v,     calldirect_v,
+
+    /* Operands known to be numbers (-O2) */
+    add_nn_v,       sub_nn_v,       mul_nn_v,
+    div_nn_v,       mod_nn_v,       jeq_nn_v,
+    jne_nn_v,       jle_nn_v,       jge_nn_v,
+    jlt_nn_v,       jgt_nn_v,       assign_num_v,
     nop_v
 } vmopcode;
 
@@ -56,6 +63,8 @@ typedef struct userfunc {
 
 typedef void (*generator_func_t)(Quad*);
 
+extern Arena operandArena;  /* vmargs of every emitted instruction; freed by freeInstructions */
+
 void generate_ADD (Quad *quad);
 void generate_SUB (Quad *quad);
 void generate_MUL (Quad *quad);
@@ -90,6 +99,7 @@ void make_boolOperand(vmarg *arg, unsigned val);
 void make_retvalOperand(vmarg *arg);
 
 void generate(void);
+void freeInstructions(void);
 unsigned consts_newString(char *s);
 unsigned consts_newNum(double n);
 unsigned libfuncs_newused(char *s);
@@ -0,0 +1,19 @@
+#ifndef TEMP_ALLOC_H
+#define TEMP_ALLOC_H
+
+#define TEMP_ALLOC_INITIAL_UNITS 16
+
+/*
+ * newtemp gives every subexpression a slot of its own. This pass computes
+ * where each temporary is live, in every function body and in the
+ * top-level code, and lets temporaries whose live ranges do not overlap
+ * share a slot (linear scan). localCount and programVarCount shrink to the
+ * variables still referenced plus the slots needed. Runs after peephole,
+ * before generate.
+ */
+void allocate_temps(void);
+
+extern unsigned long tempsAllocated;    /* temporaries given a slot */
+extern unsigned long tempSlots;         /* slots they share */
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef TYPE_INFER_H
+#define TYPE_INFER_H
+
+#include "cfg.h"
+
+/*
+ * Flow-sensitive number inference over SSA form. A value is a number when
+ * arithmetic made it, or when it is a copy or phi of numbers only; the
+ * phis of a loop are assumed numbers until an argument says otherwise.
+ * The VM stops on arithmetic or ordering a non-number, so an operand of
+ * one is also a number wherever it dominates. Arithmetic, comparisons and
+ * copies reading numbers only get Quad.numeric, which makes generate
+ * emit the typed opcodes; so do the copies lowering a phi of numbers.
+ * Returns how many quads and phis were marked.
+ */
+unsigned long infer_types(cfg_program *p, unsigned func);
+
+#endif
@@ -8,11 +8,16 @@
 #include "stack.h"
 #include "targetcode.h"
 #include "scope_offset_manager.h"
+#include "compile_stats.h"
+#include "intern.h"
+#include "passes.h"
 #include "parser.tab.h"
 
 #define YY_DECL int yylex(void)
 extern int yylex(void);
-extern FILE *yyin;
+extern int lexer_open(const char *path);
+extern void lexer_rewind(void);
+extern void freeLexer(void);
 
 extern int yylineno;
 void yyerror(const char *msg);
@@ -21,13 +26,16 @@ unsigned int programVarCount = 0;
 void updateProgramVarCount(SymTableEntry *entry);
 
 unsigned int currentScope = 0;
-int isFunctionScopes[MAX_SCOPE] = {0};
+int *isFunctionScopes = NULL;
+unsigned int isFunctionScopesSize = 0;
+void markFunctionScope(unsigned int scope);
 int isFunctionScope(unsigned int scope);
 int isLoop = 0;
 
 static void *offsetStack;
 int currentOffset = 0;
 void initOffsetStack();
+void freeOffsetStack();
 
 static int anon_func = 0;
 SymTable* symTable;
@@ -88,7 +96,7 @@ program:    stmt_list
             ;
 
 stmt_list:  { make_stmt(&$$); }
-            | stmt stmt_list {
+            | stmt_list stmt {
                 $$ = $1;
                 $$->breaklist = mergelist($1->breaklist, $2->breaklist);
                 $$->contlist = mergelist($1->contlist, $2->contlist);
@@ -97,7 +105,11 @@ stmt_list:  { make_stmt(&$$); }
             ;
 
 stmt:       expr SEMICOLON {
-                $1 = emit_eval_var($1);
+                /* a condition whose value is dropped only needs its jumps */
+                if($1->type == boolexpr_e) {
+                    patchlist($1->truelist, nextQuadLabel());
+                    patchlist($1->falselist, nextQuadLabel());
+                }
                 make_stmt(&$$);
             }
             | ifstmt
@@ -128,123 +140,183 @@ stmt:       expr SEMICOLON {
             | SEMICOLON { make_stmt(&$$); }
             ;
 
-expr:       expr PLUS expr {
-                if(!isArithExpr($1) || !isArithExpr($3))
+expr:       expr PLUS { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
+                if($4->type == boolexpr_e) $4 = emit_eval($4);
+                if(!isArithExpr($1) || !isArithExpr($4))
                     fprintf(stderr, "\033[1;31mError:\033[0m Invalid operands to '+' operator (line %d)\n", yylineno);
 
-                $$ = newExpr(arithexpr_e);
-                $$->sym = newtemp();
-                emit(add, $1, $3, $$, 0);
+                $$ = fold_arith(add, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(arithexpr_e);
+                    $$->sym = newtemp();
+                    emit(add, $1, $4, $$, 0);
+                }
             }
-            | expr MINUS expr {
-                if(!isArithExpr($1) || !isArithExpr($3))
+            | expr MINUS { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
+                if($4->type == boolexpr_e) $4 = emit_eval($4);
+                if(!isArithExpr($1) || !isArithExpr($4))
                     fprintf(stderr, "\033[1;31mError:\033[0m Invalid operands to '-' operator (line %d)\n", yylineno);
 
-                $$ = newExpr(arithexpr_e);
-                $$->sym = newtemp();
-                emit(sub, $1, $3, $$, 0);
+                $$ = fold_arith(sub, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(arithexpr_e);
+                    $$->sym = newtemp();
+                    emit(sub, $1, $4, $$, 0);
+                }
             }
-            | expr MULTIPLY expr {
-                if(!isArithExpr($1) || !isArithExpr($3))
+            | expr MULTIPLY { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
+                if($4->type == boolexpr_e) $4 = emit_eval($4);
+                if(!isArithExpr($1) || !isArithExpr($4))
                     fprintf(stderr, "\033[1;31mError:\033[0m Invalid operands to '*' operator (line %d)\n", yylineno);
 
-                $$ = newExpr(arithexpr_e);
-                $$->sym = newtemp();
-                emit(mul, $1, $3, $$, 0);
+                $$ = fold_arith(mul, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(arithexpr_e);
+                    $$->sym = newtemp();
+                    emit(mul, $1, $4, $$, 0);
+                }
             }
-            | expr DIVIDE expr {
-                if(!isArithExpr($1) || !isArithExpr($3))
+            | expr DIVIDE { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
+                if($4->type == boolexpr_e) $4 = emit_eval($4);
+                if(!isArithExpr($1) || !isArithExpr($4))
                     fprintf(stderr, "\033[1;31mError:\033[0m Invalid operands to '/' operator (line %d)\n", yylineno);
-                if($3->type == constnum_e && $3->numConst == 0)
+                if($4->type == constnum_e && $4->numConst == 0)
                     fprintf(stderr, "\033[1;31mError:\033[0m Division by zero (line %d)\n", yylineno);
 
-                $$ = newExpr(arithexpr_e);
-                $$->sym = newtemp();
-                emit(div_op, $1, $3, $$, 0);
+                $$ = fold_arith(div_op, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(arithexpr_e);
+                    $$->sym = newtemp();
+                    emit(div_op, $1, $4, $$, 0);
+                }
             }
-            | expr MOD expr {
-                if(!isArithExpr($1) || !isArithExpr($3))
+            | expr MOD { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
+                if($4->type == boolexpr_e) $4 = emit_eval($4);
+                if(!isArithExpr($1) || !isArithExpr($4))
                     fprintf(stderr, "\033[1;31mError:\033[0m Invalid operands to '%%' operator (line %d)\n", yylineno);
 
-                $$ = newExpr(arithexpr_e);
-                $$->sym = newtemp();
-                emit(mod_op, $1, $3, $$, 0);
+                $$ = fold_arith(mod_op, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(arithexpr_e);
+                    $$->sym = newtemp();
+                    emit(mod_op, $1, $4, $$, 0);
+                }
             }
-            | expr GREATER { if($1->type == boolexpr_e) $1 = emit_eval($1) } expr {
+            | expr GREATER { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
                 if($4->type == boolexpr_e) $4 = emit_eval($4);
-                $$ = newExpr(boolexpr_e);
+                $$ = fold_relop(if_greater, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(boolexpr_e);
 
-                $$->truelist = nextQuadLabel();
-                $$->falselist = nextQuadLabel() + 1;
+                    $$->truelist = nextQuadLabel();
+                    $$->falselist = nextQuadLabel() + 1;
 
-                emit(if_greater, $1, $4, NULL, 0);
-                emit(jump, NULL, NULL, NULL, 0);
+                    emit(if_greater, $1, $4, NULL, 0);
+                    emit(jump, NULL, NULL, NULL, 0);
+                }
             }
-            | expr GREATER_EQUAL { if($1->type == boolexpr_e) $1 = emit_eval($1) } expr {
+            | expr GREATER_EQUAL { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
                 if($4->type == boolexpr_e) $4 = emit_eval($4);
-                $$ = newExpr(boolexpr_e);
+                $$ = fold_relop(if_greatereq, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(boolexpr_e);
 
-                $$->truelist = nextQuadLabel();
-                $$->falselist = nextQuadLabel() + 1;
+                    $$->truelist = nextQuadLabel();
+                    $$->falselist = nextQuadLabel() + 1;
 
-                emit(if_greatereq, $1, $4, NULL, 0);
-                emit(jump, NULL, NULL, NULL, 0);
+                    emit(if_greatereq, $1, $4, NULL, 0);
+                    emit(jump, NULL, NULL, NULL, 0);
+                }
             }
-            | expr LESS { if($1->type == boolexpr_e) $1 = emit_eval($1) } expr {
+            | expr LESS { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
                 if($4->type == boolexpr_e) $4 = emit_eval($4);
-                $$ = newExpr(boolexpr_e);
+                $$ = fold_relop(if_less, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(boolexpr_e);
 
-                $$->truelist = nextQuadLabel();
-                $$->falselist = nextQuadLabel() + 1;
+                    $$->truelist = nextQuadLabel();
+                    $$->falselist = nextQuadLabel() + 1;
 
-                emit(if_less, $1, $4, NULL, 0);
-                emit(jump, NULL, NULL, NULL, 0);
+                    emit(if_less, $1, $4, NULL, 0);
+                    emit(jump, NULL, NULL, NULL, 0);
+                }
             }
-            | expr LESS_EQUAL { if($1->type == boolexpr_e) $1 = emit_eval($1) } expr {
+            | expr LESS_EQUAL { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
                 if($4->type == boolexpr_e) $4 = emit_eval($4);
-                $$ = newExpr(boolexpr_e);
+                $$ = fold_relop(if_lesseq, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(boolexpr_e);
 
-                $$->truelist = nextQuadLabel();
-                $$->falselist = nextQuadLabel() + 1;
+                    $$->truelist = nextQuadLabel();
+                    $$->falselist = nextQuadLabel() + 1;
 
-                emit(if_lesseq, $1, $4, NULL, 0);
-                emit(jump, NULL, NULL, NULL, 0);
+                    emit(if_lesseq, $1, $4, NULL, 0);
+                    emit(jump, NULL, NULL, NULL, 0);
+                }
             }
-            | expr EQUAL { if($1->type == boolexpr_e) $1 = emit_eval($1) } expr {
+            | expr EQUAL { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
                 if($4->type == boolexpr_e) $4 = emit_eval($4);
-                $$ = newExpr(boolexpr_e);
+                $$ = fold_relop(if_eq, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(boolexpr_e);
 
-                $$->truelist = nextQuadLabel();
-                $$->falselist = nextQuadLabel() + 1;
+                    $$->truelist = nextQuadLabel();
+                    $$->falselist = nextQuadLabel() + 1;
 
-                emit(if_eq, $1, $4, NULL, 0);
-                emit(jump, NULL, NULL, NULL, 0);
+                    emit(if_eq, $1, $4, NULL, 0);
+                    emit(jump, NULL, NULL, NULL, 0);
+                }
             }
-            | expr NEQUAL  { if($1->type == boolexpr_e) $1 = emit_eval($1) } expr {
+            | expr NEQUAL  { if($1->type == boolexpr_e) $1 = emit_eval($1); } expr {
                 if($4->type == boolexpr_e) $4 = emit_eval($4);
-                $$ = newExpr(boolexpr_e);
+                $$ = fold_relop(if_noteq, $1, $4);
+                if(!$$) {
+                    $$ = newExpr(boolexpr_e);
 
-                $$->truelist = nextQuadLabel();
-                $$->falselist = nextQuadLabel() + 1;
+                    $$->truelist = nextQuadLabel();
+                    $$->falselist = nextQuadLabel() + 1;
 
-                emit(if_noteq, $1, $4, NULL, 0);
-                emit(jump, NULL, NULL, NULL, 0);
+                    emit(if_noteq, $1, $4, NULL, 0);
+                    emit(jump, NULL, NULL, NULL, 0);
+                }
             }
-            | expr AND { if($1->type!=boolexpr_e) $1 = evaluate($1); } M expr {
-                if($5->type != boolexpr_e) $5 = evaluate($5);
-                patchlist($1->truelist, $4);
+            | expr AND {
+                /* a true left side is dropped: the result is the right side */
+                unsigned char value;
+                if($1->type != boolexpr_e && !(const_tobool($1, &value) && value)) $1 = evaluate($1);
+            } M expr {
+                unsigned char value;
+
+                if($1->type != boolexpr_e) {
+                    if(const_tobool($5, &value)) $$ = newExpr_constbool(value);
+                    else $$ = evaluate($5);
+                } else {
+                    if($5->type != boolexpr_e) $5 = evaluate($5);
+                    patchlist($1->truelist, $4);
 
-                $$ = newExpr(boolexpr_e);
-                $$->truelist = $5->truelist;
-                $$->falselist = mergelist($1->falselist, $5->falselist);
+                    $$ = newExpr(boolexpr_e);
+                    $$->truelist = $5->truelist;
+                    $$->falselist = mergelist($1->falselist, $5->falselist);
+                }
             }
-            | expr OR { if($1->type!=boolexpr_e) $1 = evaluate($1); } M expr {
-                if($5->type != boolexpr_e) $5 = evaluate($5);
-                patchlist($1->falselist, $4);
+            | expr OR {
+                /* likewise a false left side */
+                unsigned char value;
+                if($1->type != boolexpr_e && !(const_tobool($1, &value) && !value)) $1 = evaluate($1);
+            } M expr {
+                unsigned char value;
+
+                if($1->type != boolexpr_e) {
+                    if(const_tobool($5, &value)) $$ = newExpr_constbool(value);
+                    else $$ = evaluate($5);
+                } else {
+                    if($5->type != boolexpr_e) $5 = evaluate($5);
+                    patchlist($1->falselist, $4);
 
-                $$ = newExpr(boolexpr_e);
-                $$->truelist = mergelist($1->truelist, $5->truelist);
-                $$->falselist = $5->falselist;
+                    $$ = newExpr(boolexpr_e);
+                    $$->truelist = mergelist($1->truelist, $5->truelist);
+                    $$->falselist = $5->falselist;
+                }
             }
             | term { $$ = $1; }
             | assignexpr { $$ = $1; }
@@ -252,21 +324,30 @@ expr:       expr PLUS expr {
 
 M:          { $$ = nextQuadLabel(); }
 
-term:       LPAREN expr RPAREN { $$ = $2; if($2->type == boolexpr_e) $2 = emit_eval($2); }
+term:       LPAREN expr RPAREN { $$ = $2; }
             | MINUS expr %prec UMINUS {
-                $$ = newExpr(arithexpr_e);
-                $$->sym = newtemp();
-                emit(uminus, $2, NULL, $$, 0);
+                if($2->type == boolexpr_e) $2 = emit_eval_var($2);
+                $$ = fold_arith(uminus, $2, NULL);
+                if(!$$) {
+                    $$ = newExpr(arithexpr_e);
+                    $$->sym = newtemp();
+                    emit(uminus, $2, NULL, $$, 0);
+                }
             }
             | NOT expr {
-                if($2->type != boolexpr_e) $2 = evaluate($2);
-                
-                unsigned temp1 = $2->truelist;
-                unsigned temp2 = $2->falselist;
+                unsigned char value;
 
-                $$ = $2;
-                $$->truelist = temp2;
-                $$->falselist = temp1;
+                if(const_tobool($2, &value)) $$ = newExpr_constbool(!value);
+                else {
+                    if($2->type != boolexpr_e) $2 = evaluate($2);
+
+                    unsigned temp1 = $2->truelist;
+                    unsigned temp2 = $2->falselist;
+
+                    $$ = $2;
+                    $$->truelist = temp2;
+                    $$->falselist = temp1;
+                }
             }
             | INCR lvalue {
                 if($2 && $2->sym && ($2->sym->type == USERFUNC || $2->sym->type == LIBFUNC))
@@ -298,7 +379,6 @@ term:       LPAREN expr RPAREN { $$ = $2; if($2->type == boolexpr_e) $2 = emit_e
                     emit(assign, tmp, NULL, $$, 0);
                     emit(add, tmp, newExpr_constnum(1), tmp, 0);
                     emit(tablesetelem, $1->index, tmp, $1->table, 0);
-                    $$ = tmp;
                 } else {
                     emit(assign, $1, NULL, $$, 0);
                     emit(add, $1, newExpr_constnum(1), $1, 0);
@@ -334,7 +414,6 @@ term:       LPAREN expr RPAREN { $$ = $2; if($2->type == boolexpr_e) $2 = emit_e
                     emit(assign, tmp, NULL, $$, 0);
                     emit(sub, tmp, newExpr_constnum(1), tmp, 0);
                     emit(tablesetelem, $1->index, tmp, $1->table, 0);
-                    $$ = tmp;
                 } else {
                     emit(assign, $1, NULL, $$, 0);
                     emit(sub, $1, newExpr_constnum(1), $1, 0);
@@ -474,6 +553,7 @@ member:     lvalue DOT IDENTIFIER {
                 $$ = member_item($1, newExpr_conststring($3));
             }
             | lvalue LBRACKET expr RBRACKET {
+                if($3->type == boolexpr_e) $3 = emit_eval_var($3);
                 if($1->type == var_e) {
                     int varType = (currentScope == 0) ? GLOBAL_VAR : LOCAL_VAR;
                     SymTableEntry *tmp = SymTable_LookupAny(symTable, $1->sym->name);
@@ -482,10 +562,11 @@ member:     lvalue DOT IDENTIFIER {
                 $$ = member_item($1, $3);
             }
             | call DOT IDENTIFIER { 
-                $$ = $1;
+                $$ = member_item($1, newExpr_conststring($3));
             }
             | call LBRACKET expr RBRACKET { 
-                $$ = $1;
+                if($3->type == boolexpr_e) $3 = emit_eval_var($3);
+                $$ = member_item($1, $3);
             }
             ;
 
@@ -538,7 +619,7 @@ callsuffix: normcall { $$ = $1; }
             ;
 
 normcall:   LPAREN elist RPAREN {
-                $$ = malloc(sizeof(FunctCont_t));
+                $$ = arena_alloc(&irArena, sizeof(FunctCont_t));
                 $$->elist = $2;
                 $$->method = 0;
                 $$->name = NULL;
@@ -546,7 +627,7 @@ normcall:   LPAREN elist RPAREN {
             ;
 
 methodcall: DBL_DOT IDENTIFIER LPAREN elist RPAREN {
-                $$ = malloc(sizeof(FunctCont_t));
+                $$ = arena_alloc(&irArena, sizeof(FunctCont_t));
                 $$->elist = $4;
                 $$->method = 1;
                 $$->name = $2;
@@ -554,25 +635,23 @@ methodcall: DBL_DOT IDENTIFIER LPAREN elist RPAREN {
             ;
 
 elist:      { $$ = NULL; }
-            | expr elist_expr {
-                if($1->type == boolexpr_e) $1 = emit_eval_var($1);
+            | expr { if($1->type == boolexpr_e) $1 = emit_eval_var($1); } elist_expr {
                 $$ = $1;
-                if($2) $1->next = $2;                
+                if($3) $1->next = $3;
             }
             ;
 
 elist_expr: { $$ = NULL; }
-            | COMMA expr elist_expr {
+            | COMMA expr { if($2->type == boolexpr_e) $2 = emit_eval_var($2); } elist_expr {
                 $$ = $2;
-                if($3) $2->next = $3;
+                if($4) $2->next = $4;
             }
             ;
 
 /* This rule helps with conflict of objectdef */
-notempty_elist: expr elist_expr {
-                if($1->type == boolexpr_e) $1 = emit_eval_var($1);
+notempty_elist: expr { if($1->type == boolexpr_e) $1 = emit_eval_var($1); } elist_expr {
                 $$ = $1;
-                if($2) $1->next = $2;
+                if($3) $1->next = $3;
             }
             ;
 
@@ -619,9 +698,9 @@ indexedelem_list: { $$ = NULL; }
                 }
                 ;
 
-indexedelem: LBRACE expr COLON expr RBRACE {
-                if($4->type == boolexpr_e) $4 = emit_eval_var($4);
-                $$ = $4;
+indexedelem: LBRACE expr { if($2->type == boolexpr_e) $2 = emit_eval_var($2); } COLON expr RBRACE {
+                if($5->type == boolexpr_e) $5 = emit_eval_var($5);
+                $$ = $5;
                 $$->index = $2;
             }
             ;
@@ -632,20 +711,12 @@ block:      LBRACE {
                 
                 if(isFunctionMainBlock) {
                     functionBlockScope = currentScope;
-                } else { 
-                    if(currscopespace() == PROGRAM_SPACE) {
-                        enterBlock();
-                    }
                 }
             } stmt_list RBRACE {
                 int isFunctionMainBlock = (currentScope == functionBlockScope);
                 if(isFunctionMainBlock && currFunc) {
                     currFunc->localCount = currscopeoffset();
                     functionBlockScope = 0;
-                } else {
-                    if(currscopespace() == PROGRAM_SPACE) {
-                        exitBlock(0);
-                    }
                 }
                 
                 $$ = $3;
@@ -679,7 +750,7 @@ funcprefix: FUNCTION IDENTIFIER {
                 }
             }
             | FUNCTION {
-                char *name = malloc(16 * sizeof(char));
+                char name[16];
                 sprintf(name, "$f%d", anon_func++);
 
                 $$ = SymTable_Insert(symTable, name, currentScope, yylineno, USERFUNC);
@@ -696,13 +767,12 @@ funcprefix: FUNCTION IDENTIFIER {
                     
                     enterFunctionPrefix();
                 }
-                free(name);
             }
             ;
 
 funcargs:   LPAREN { 
                 ++currentScope;
-                isFunctionScopes[currentScope] = 1;
+                markFunctionScope(currentScope);
             } idlist RPAREN { 
                 enterFunctionLocals();
                 --currentScope;
@@ -764,7 +834,7 @@ idlist:     {  }
             ;
 
 idlist_tail:    { $$ = NULL; }
-                | COMMA IDENTIFIER idlist_tail {
+                | COMMA IDENTIFIER {
                     SymTableEntry *libFunc = SymTable_Lookup(symTable, $2, 0);
 
                     if(libFunc && libFunc->type == LIBFUNC) {
@@ -794,7 +864,8 @@ idlist_tail:    { $$ = NULL; }
                             assignSymbolSpaceAndOffset(newEntry);
                         }
                     }
-                    $$ = $3;
+                } idlist_tail {
+                    $$ = $4;
                 }
                 ;
 
@@ -819,19 +890,19 @@ const:      INTCONST {
             ;
 
 ifprefix:   IF LPAREN expr RPAREN {
-                Expr* evaluated_expr = emit_eval_var($3);
-                emit(if_eq, evaluated_expr, newExpr_constbool(1), NULL, nextQuadLabel() + 2);
-                $$ = nextQuadLabel();
-                emit(jump, NULL, NULL, NULL, 0);
+                /* branch straight off the condition; ifstmt patches the false exits */
+                Expr* cond = evaluate($3);
+                patchlist(cond->truelist, nextQuadLabel());
+                $$ = cond->falselist;
             }
             ;
 
 ifstmt:     ifprefix stmt {
-                patchlabel($1, nextQuadLabel());
+                patchlist($1, nextQuadLabel());
                 $$ = $2;
             }
             | ifprefix stmt ELSE jumpandsavepos stmt {
-                patchlabel($1, $4 + 1);
+                patchlist($1, $4 + 1);
                 patchlabel($4, nextQuadLabel()); 
                 make_stmt(&$$);
                 $$->breaklist = mergelist($2->breaklist, $5->breaklist);
@@ -850,16 +921,15 @@ whilestart: WHILE { $$ = nextQuadLabel(); }
             ;
 
 whilecond:  LPAREN expr RPAREN {
-                Expr* evaluated_expr = emit_eval_var($2);
-                emit(if_eq, evaluated_expr, newExpr_constbool(1), NULL, nextQuadLabel() + 2);
-                $$ = nextQuadLabel();
-                emit(jump, NULL, NULL, NULL, 0);
+                Expr* cond = evaluate($2);
+                patchlist(cond->truelist, nextQuadLabel());
+                $$ = cond->falselist;
             }
             ;
 
 whilestmt:  whilestart { ++isLoop; } whilecond stmt {--isLoop;} {
                 emit(jump, NULL, NULL, NULL, $1);
-                patchlabel($3, nextQuadLabel());
+                patchlist($3, nextQuadLabel());
 
                 make_stmt(&$$);
                 patchlist($4->breaklist, nextQuadLabel());
@@ -872,18 +942,18 @@ whilestmt:  whilestart { ++isLoop; } whilecond stmt {--isLoop;} {
             ;
 
 forprefix:  FOR { ++isLoop; } LPAREN elist M SEMICOLON expr SEMICOLON {
-                Expr* evaluated_expr = emit_eval_var($7);
+                Expr* cond = evaluate($7);
                 
-                $$ = malloc(sizeof(forstmt_t));
+                $$ = arena_alloc(&irArena, sizeof(forstmt_t));
                 $$->test = $5;
-                $$->enter = nextQuadLabel();
-
-                emit(if_eq, evaluated_expr, newExpr_constbool(1), NULL, 0);
+                $$->enter = cond->truelist;
+                $$->exit = cond->falselist;
             }
             ;
 
 forstmt:    forprefix jumpandsavepos elist RPAREN jumpandsavepos stmt jumpandsavepos { --isLoop; } {
-                patchlabel($1->enter, $5 + 1);
+                patchlist($1->enter, $5 + 1);
+                patchlist($1->exit, nextQuadLabel());
                 patchlabel($7, $2 + 1);
                 patchlabel($2, nextQuadLabel());
                 patchlabel($5, $1->test);
@@ -922,25 +992,38 @@ returnstmt: RETURN SEMICOLON {
 %%
 
 int main(int argc, char **argv) {
-    FILE *input_file = stdin;
     FILE *output_file = NULL;
     char *output_filename = NULL;
     int debug_mode = 0;
+    int phase_times = 0;
+    int stats_mode = 0;     /* 1 text, 2 JSON */
 
     if(argc < 2) {
-        fprintf(stderr, "Usage: %s <input.alpha> [output.abc] [--debug]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <input.alpha> [output.abc] [-O0|-O1|-O2] [--debug] [--phase-times] [--stats[=json]]\n", argv[0]);
         return 1;
     }
 
-    for(int i = 1; i < argc; i++) if(strcmp(argv[i], "--debug") == 0) debug_mode = 1;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--debug") == 0) debug_mode = 1;
+        else if(strcmp(argv[i], "--phase-times") == 0) phase_times = 1;
+        else if(strcmp(argv[i], "--stats") == 0) stats_mode = 1;
+        else if(strcmp(argv[i], "--stats=json") == 0) stats_mode = 2;
+        else if(strncmp(argv[i], "-O", 2) == 0) {
+            if(argv[i][2] < '0' || argv[i][2] > '2' || argv[i][3]) {
+                fprintf(stderr, "Unknown optimization level: %s\n", argv[i]);
+                return 1;
+            }
+            optLevel = argv[i][2] - '0';
+        }
+    }
 
-    if(!(input_file = fopen(argv[1], "r"))) {
+    if(lexer_open(argv[1]) != 0) {
         fprintf(stderr, "Cannot read file: %s\n", argv[1]);
         return 1;
     }
 
     // Determine output filename
-    if(argc > 2 && strcmp(argv[2], "--debug") != 0) output_filename = argv[2];
+    if(argc > 2 && argv[2][0] != '-') output_filename = argv[2];
     else {
         char *dot = strrchr(argv[1], '.');
         if(dot) {
@@ -960,34 +1043,61 @@ int main(int argc, char **argv) {
     initOffsetStack();
     initOffsetManagement();
 
-    yyin = input_file;
-    
+    // yyparse pulls tokens as it goes, so the lexer gets a pass of its own
+    if(phase_times) {
+        phase_begin();
+        while(yylex() != 0);
+        phase_end(PHASE_LEX);
+
+        lexer_rewind();
+    }
+
+    phase_begin();
     if(yyparse() != 0) {
         fprintf(stderr, "Parsing failed\n");
-        fclose(input_file);
+        freeLexer();
         return 1;
     }
-    
+    phase_end(PHASE_PARSE);
+
+    // Report parse time without the tokenizing measured above
+    if(phase_times) {
+        phaseStats[PHASE_PARSE].seconds -= phaseStats[PHASE_LEX].seconds;
+        if(phaseStats[PHASE_PARSE].seconds < 0) phaseStats[PHASE_PARSE].seconds = 0;
+    }
+
+    phase_begin();
+    run_passes();
     generate();
+    phase_end(PHASE_GENERATE);
     
     if(!(output_file = fopen(output_filename, "wb"))) {
         fprintf(stderr, "Cannot write file: %s\n", output_filename);
-        fclose(input_file);
+        freeLexer();
         return 1;
     }
     
+    phase_begin();
     write_binary_file(output_file);
     fclose(output_file);
+    phase_end(PHASE_WRITE);
     
     printf("Compilation successful: %s -> %s\n", argv[1], output_filename);
     
+    if(phase_times) print_phase_times(stdout, argv[1]);
+    if(stats_mode) print_compile_stats(stdout, stats_mode == 2);
+
     if(debug_mode) printEverything(1, 1, 1, 1);
 
-    SymTable_Free(symTable);    
-    if(quads) free(quads);
-    fclose(input_file);
-    
-    if(argc <= 2 || strcmp(argv[2], "--debug") == 0) free(output_filename);
+    SymTable_Free(symTable);
+    freeQuads();
+    freeInstructions();
+    freeOffsetStack();
+    free(isFunctionScopes);
+    freeLexer();
+    intern_free();
+
+    if(output_filename != argv[2]) free(output_filename);
 
     return 0;
 }
@@ -996,8 +1106,23 @@ void yyerror(const char *msg) {
     fprintf(stderr, "\033[1;31mSyntax Error\033[0m at line %d: %s\n", yylineno, msg);
 }
 
+void markFunctionScope(unsigned int scope) {
+    if(scope >= isFunctionScopesSize) {
+        unsigned int size = isFunctionScopesSize ? isFunctionScopesSize : SYMTABLE_INITIAL_SCOPES;
+
+        while(size <= scope) size *= 2;
+
+        isFunctionScopes = realloc(isFunctionScopes, size * sizeof(int));
+        assert(isFunctionScopes);
+        memset(isFunctionScopes + isFunctionScopesSize, 0, (size - isFunctionScopesSize) * sizeof(int));
+        isFunctionScopesSize = size;
+    }
+
+    isFunctionScopes[scope] = 1;
+}
+
 int isFunctionScope(unsigned int scope) {
-    if(scope < MAX_SCOPE) return isFunctionScopes[scope];
+    if(scope < isFunctionScopesSize) return isFunctionScopes[scope];
     return 0;
 }
 
@@ -1009,6 +1134,14 @@ void initOffsetStack() {
     currentOffset = 0;
 }
 
+void freeOffsetStack() {
+    int *off;
+
+    while((off = popStack(offsetStack))) free(off);
+    offsetStack = destroyStack(offsetStack);
+    freeOffsetManagement();
+}
+
 void printEverything(int symbols, int quads, int instructions, int constants) {
     int flags[] = {symbols, quads, instructions, constants};
     const char* headers[] = {
@@ -0,0 +1,71 @@
+#include "../headers/arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN sizeof(max_align_t)
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct arena_chunk {
+    arena_chunk *prev;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+};
+
+/* Chunks come from calloc and are never reused, so every allocation starts zeroed */
+static arena_chunk *arena_grow(Arena *arena, size_t size) {
+    size_t chunkSize = arena->nextSize;
+
+    while(chunkSize < size) chunkSize *= 2;
+
+    arena_chunk *chunk = calloc(1, sizeof(arena_chunk) + chunkSize);
+    if(!chunk) {
+        fprintf(stderr, "Error: Memory allocation failed for arena chunk\n");
+        exit(1);
+    }
+
+    chunk->prev = arena->head;
+    chunk->size = chunkSize;
+    chunk->used = 0;
+
+    arena->head = chunk;
+    arena->reserved += chunkSize;
+    arena->chunks++;
+    if(arena->nextSize < ARENA_MAX_CHUNK) arena->nextSize *= 2;
+
+    return chunk;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    arena_chunk *chunk = arena->head;
+
+    size = ARENA_ROUND(size ? size : 1);
+    if(!chunk || chunk->size - chunk->used < size) chunk = arena_grow(arena, size);
+
+    void *p = (char *)chunk->data + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    return p;
+}
+
+char *arena_strdup(Arena *arena, const char *s) {
+    size_t len = strlen(s) + 1;
+    return memcpy(arena_alloc(arena, len), s, len);
+}
+
+void arena_free(Arena *arena) {
+    arena_chunk *chunk = arena->head;
+
+    while(chunk) {
+        arena_chunk *prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+
+    arena->head = NULL;
+    arena->nextSize = ARENA_FIRST_CHUNK;
+    arena->used = 0;
+    arena->reserved = 0;
+    arena->chunks = 0;
+}
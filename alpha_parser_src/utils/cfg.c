@@ -0,0 +1,478 @@
+#include "../headers/cfg.h"
+
+void *cfg_calloc(size_t count, size_t size) {
+    void *p = calloc(count ? count : 1, size);
+    if(!p) {
+        fprintf(stderr, "Error: Memory allocation failed for control flow graph\n");
+        exit(1);
+    }
+    return p;
+}
+
+/* Makes room for one more element at index used */
+void *cfg_reserve(void *array, unsigned used, unsigned *size, size_t elem) {
+    if(used < *size) return array;
+
+    *size = *size ? *size * 2 : CFG_INITIAL_SIZE;
+    array = realloc(array, *size * elem);
+    if(!array) {
+        fprintf(stderr, "Error: Memory allocation failed for control flow graph\n");
+        exit(1);
+    }
+    return array;
+}
+
+int cfg_defines(cfg_instr *instr, int operand) {
+    return operand == CFG_RESULT && writesResult(instr->quad.op);
+}
+
+Expr **cfg_operand(cfg_instr *instr, int operand) {
+    switch(operand) {
+    case CFG_RESULT: return &instr->quad.result;
+    case CFG_ARG1: return &instr->quad.arg1;
+    default: return &instr->quad.arg2;
+    }
+}
+
+unsigned cfg_successors(cfg_block *b, unsigned succ[2]) {
+    unsigned count = 0;
+
+    if(b->target < CFG_EXIT) succ[count++] = b->target;
+    if(b->fallthrough < CFG_EXIT) succ[count++] = b->fallthrough;
+    return count;
+}
+
+unsigned cfg_new_block(cfg_function *f) {
+    cfg_block *b;
+
+    f->blocks = cfg_reserve(f->blocks, f->blockCount, &f->blockSize, sizeof(cfg_block));
+    b = &f->blocks[f->blockCount];
+    memset(b, 0, sizeof(cfg_block));
+    b->fallthrough = b->target = CFG_NONE;
+    b->rpo = b->idom = CFG_NONE;
+    b->nextFunc = b->nextBlock = CFG_NONE;
+    return f->blockCount++;
+}
+
+static void add_pred(cfg_block *b, unsigned pred, int branch) {
+    b->preds = cfg_reserve(b->preds, b->predCount, &b->predSize, sizeof(cfg_edge));
+    b->preds[b->predCount].block = pred;
+    b->preds[b->predCount].branch = branch;
+    ++b->predCount;
+}
+
+cfg_instr *cfg_insert(cfg_function *f, unsigned block, unsigned pos, Quad *quad) {
+    cfg_block *b = &f->blocks[block];
+
+    b->instrs = cfg_reserve(b->instrs, b->count, &b->size, sizeof(cfg_instr));
+    memmove(&b->instrs[pos + 1], &b->instrs[pos], (b->count - pos) * sizeof(cfg_instr));
+    ++b->count;
+
+    memset(&b->instrs[pos], 0, sizeof(cfg_instr));
+    b->instrs[pos].quad = *quad;
+    return &b->instrs[pos];
+}
+
+static void lay_out(cfg_program *p, unsigned func, unsigned block, unsigned *prevFunc, unsigned *prevBlock) {
+    if(*prevFunc == CFG_NONE) {
+        p->headFunc = func;
+        p->headBlock = block;
+    }
+    else {
+        p->funcs[*prevFunc].blocks[*prevBlock].nextFunc = func;
+        p->funcs[*prevFunc].blocks[*prevBlock].nextBlock = block;
+    }
+    *prevFunc = func;
+    *prevBlock = block;
+}
+
+cfg_program *cfg_build(void) {
+    if(curr_quad <= 1) return NULL;
+
+    for(unsigned i = 1; i < curr_quad; ++i)
+        if(isBranch(quads[i].op) && (quads[i].label == 0 || quads[i].label > curr_quad)) return NULL;
+
+    cfg_program *p = cfg_calloc(1, sizeof(cfg_program));
+    unsigned *funcOf = cfg_calloc(curr_quad + 1, sizeof(unsigned));
+    unsigned *blockOf = cfg_calloc(curr_quad + 1, sizeof(unsigned));
+    unsigned *open = cfg_calloc(curr_quad + 1, sizeof(unsigned));
+    unsigned depth = 0;
+
+    p->funcCount = 1;
+    for(unsigned i = 1; i < curr_quad; ++i)
+        if(quads[i].op == funcstart) ++p->funcCount;
+    p->funcs = cfg_calloc(p->funcCount, sizeof(cfg_function));
+
+    unsigned funcs = 1;
+    for(unsigned i = 1; i < curr_quad; ++i) {
+        if(quads[i].op == funcstart) {
+            cfg_function *f = &p->funcs[funcs];
+
+            f->func = quads[i].result ? quads[i].result->sym : NULL;
+            f->scope = f->func ? f->func->scope + 1 : 0;
+            open[++depth] = funcs++;
+        }
+        funcOf[i] = open[depth];
+        if(quads[i].op == funcend && depth) --depth;
+    }
+
+    /*
+     * A block starts a function, follows a branch, is branched to, or
+     * resumes its function after a nested one, so that laying the blocks
+     * out in their original order gives back the original quads.
+     */
+    unsigned *last = cfg_calloc(p->funcCount, sizeof(unsigned));
+    unsigned prevFunc = CFG_NONE, prevBlock = CFG_NONE;
+    char *leader = cfg_calloc(curr_quad + 1, 1);
+
+    for(unsigned i = 1; i < curr_quad; ++i)
+        if(isBranch(quads[i].op) && quads[i].label < curr_quad) leader[quads[i].label] = 1;
+
+    for(unsigned i = 1; i < curr_quad; ++i) {
+        unsigned u = funcOf[i];
+        cfg_function *f = &p->funcs[u];
+
+        /* An empty entry keeps the entry block free of predecessors when the first quad is branched to */
+        if(!last[u] && leader[i]) lay_out(p, u, cfg_new_block(f), &prevFunc, &prevBlock);
+        if(leader[i] || !last[u] || last[u] != i - 1 || isBranch(quads[last[u]].op))
+            lay_out(p, u, cfg_new_block(f), &prevFunc, &prevBlock);
+
+        cfg_block *b = &f->blocks[f->blockCount - 1];
+        b->instrs = cfg_reserve(b->instrs, b->count, &b->size, sizeof(cfg_instr));
+        memset(&b->instrs[b->count], 0, sizeof(cfg_instr));
+        b->instrs[b->count++].quad = quads[i];
+
+        blockOf[i] = f->blockCount - 1;
+        last[u] = i;
+    }
+
+    int valid = 1;
+    for(unsigned u = 0; u < p->funcCount && valid; ++u) {
+        cfg_function *f = &p->funcs[u];
+
+        for(unsigned b = 0; b < f->blockCount; ++b) {
+            cfg_block *block = &f->blocks[b];
+            Quad *q;
+
+            if(!block->count) {
+                block->fallthrough = b + 1;
+                continue;
+            }
+
+            q = &block->instrs[block->count - 1].quad;
+            if(isBranch(q->op)) {
+                if(q->label == curr_quad) block->target = CFG_EXIT;
+                else if(funcOf[q->label] == u) block->target = blockOf[q->label];
+                else {
+                    valid = 0;
+                    break;
+                }
+                q->label = block->target;
+            }
+
+            if(q->op != jump && q->op != funcend)
+                block->fallthrough = b + 1 < f->blockCount ? b + 1 : CFG_EXIT;
+        }
+    }
+
+    free(leader);
+    free(last);
+    free(open);
+    free(blockOf);
+    free(funcOf);
+
+    if(!valid || !p->funcs[0].blockCount) {
+        cfg_free(p);
+        return NULL;
+    }
+
+    for(unsigned u = 0; u < p->funcCount; ++u) cfg_link_preds(&p->funcs[u]);
+
+    return p;
+}
+
+void cfg_link_preds(cfg_function *f) {
+    for(unsigned b = 0; b < f->blockCount; ++b) f->blocks[b].predCount = 0;
+
+    for(unsigned b = 0; b < f->blockCount; ++b) {
+        if(f->blocks[b].target < CFG_EXIT) add_pred(&f->blocks[f->blocks[b].target], b, 1);
+        if(f->blocks[b].fallthrough < CFG_EXIT) add_pred(&f->blocks[f->blocks[b].fallthrough], b, 0);
+    }
+}
+
+static void add_frontier(cfg_block *b, unsigned block) {
+    if(b->frontierCount && b->frontier[b->frontierCount - 1] == block) return;
+
+    b->frontier = cfg_reserve(b->frontier, b->frontierCount, &b->frontierSize, sizeof(unsigned));
+    b->frontier[b->frontierCount++] = block;
+}
+
+static unsigned intersect(cfg_function *f, unsigned a, unsigned b) {
+    while(a != b) {
+        while(f->blocks[a].rpo > f->blocks[b].rpo) a = f->blocks[a].idom;
+        while(f->blocks[b].rpo > f->blocks[a].rpo) b = f->blocks[b].idom;
+    }
+    return a;
+}
+
+void cfg_dominators(cfg_function *f) {
+    unsigned n = f->blockCount;
+    unsigned *stack = cfg_calloc(n, sizeof(unsigned));
+    unsigned *next = cfg_calloc(n, sizeof(unsigned));
+    char *seen = cfg_calloc(n, 1);
+    unsigned top = 0, post = n;
+
+    free(f->rpoOrder);
+    f->rpoOrder = cfg_calloc(n, sizeof(unsigned));
+
+    for(unsigned b = 0; b < n; ++b) {
+        f->blocks[b].rpo = f->blocks[b].idom = CFG_NONE;
+        f->blocks[b].frontierCount = 0;
+    }
+
+    /* Postorder from the end of rpoOrder, then moved to the front */
+    stack[top++] = 0;
+    seen[0] = 1;
+    while(top) {
+        unsigned b = stack[top - 1], succ[2];
+        unsigned count = cfg_successors(&f->blocks[b], succ);
+
+        if(next[b] < count) {
+            unsigned s = succ[next[b]++];
+            if(!seen[s]) {
+                seen[s] = 1;
+                stack[top++] = s;
+            }
+            continue;
+        }
+        f->rpoOrder[--post] = b;
+        --top;
+    }
+
+    f->reachable = n - post;
+    memmove(f->rpoOrder, f->rpoOrder + post, f->reachable * sizeof(unsigned));
+    for(unsigned i = 0; i < f->reachable; ++i) f->blocks[f->rpoOrder[i]].rpo = i;
+
+    f->blocks[0].idom = 0;
+    for(int changed = 1; changed; ) {
+        changed = 0;
+
+        for(unsigned i = 1; i < f->reachable; ++i) {
+            cfg_block *b = &f->blocks[f->rpoOrder[i]];
+            unsigned idom = CFG_NONE;
+
+            for(unsigned e = 0; e < b->predCount; ++e) {
+                unsigned pred = b->preds[e].block;
+
+                if(f->blocks[pred].idom == CFG_NONE) continue;
+                idom = idom == CFG_NONE ? pred : intersect(f, pred, idom);
+            }
+
+            if(idom != b->idom) {
+                b->idom = idom;
+                changed = 1;
+            }
+        }
+    }
+
+    for(unsigned i = 1; i < f->reachable; ++i) {
+        unsigned b = f->rpoOrder[i];
+        cfg_block *block = &f->blocks[b];
+
+        if(block->predCount < 2) continue;
+        for(unsigned e = 0; e < block->predCount; ++e) {
+            unsigned runner = block->preds[e].block;
+
+            if(f->blocks[runner].rpo == CFG_NONE) continue;
+            while(runner != block->idom) {
+                add_frontier(&f->blocks[runner], b);
+                runner = f->blocks[runner].idom;
+            }
+        }
+    }
+
+    f->blocks[0].idom = CFG_NONE;
+
+    /* Dominator tree intervals */
+    unsigned *child;
+    unsigned *children = cfg_dom_children(f, &child);
+    unsigned counter = 0;
+
+    memset(next, 0, n * sizeof(unsigned));
+    top = 0;
+    stack[top++] = 0;
+    f->blocks[0].domPre = counter++;
+    while(top) {
+        unsigned b = stack[top - 1];
+
+        if(next[b] < child[b + 1] - child[b]) {
+            unsigned c = children[child[b] + next[b]++];
+            f->blocks[c].domPre = counter++;
+            stack[top++] = c;
+            continue;
+        }
+        f->blocks[b].domPost = counter++;
+        --top;
+    }
+
+    free(children);
+    free(child);
+    free(seen);
+    free(next);
+    free(stack);
+}
+
+unsigned *cfg_dom_children(cfg_function *f, unsigned **start) {
+    unsigned n = f->blockCount;
+    unsigned *child = cfg_calloc(n + 1, sizeof(unsigned));
+    unsigned *children = cfg_calloc(n, sizeof(unsigned));
+    unsigned *fill = cfg_calloc(n, sizeof(unsigned));
+
+    for(unsigned i = 1; i < f->reachable; ++i) ++child[f->blocks[f->rpoOrder[i]].idom + 1];
+    for(unsigned b = 0; b < n; ++b) child[b + 1] += child[b];
+    for(unsigned i = 1; i < f->reachable; ++i) {
+        unsigned idom = f->blocks[f->rpoOrder[i]].idom;
+        children[child[idom] + fill[idom]++] = f->rpoOrder[i];
+    }
+
+    free(fill);
+    *start = child;
+    return children;
+}
+
+int cfg_dominates(cfg_function *f, unsigned a, unsigned b) {
+    cfg_block *x = &f->blocks[a], *y = &f->blocks[b];
+
+    if(x->rpo == CFG_NONE || y->rpo == CFG_NONE) return 0;
+    return x->domPre <= y->domPre && y->domPost <= x->domPost;
+}
+
+unsigned cfg_split_edge(cfg_program *p, unsigned func, unsigned pred, int branch) {
+    cfg_function *f = &p->funcs[func];
+    unsigned s = cfg_new_block(f);
+    cfg_block *from = &f->blocks[pred], *block = &f->blocks[s];
+    unsigned succ = branch ? from->target : from->fallthrough;
+
+    block->fallthrough = succ;
+    block->idom = pred;
+    add_pred(block, pred, branch);
+
+    if(branch) {
+        from->target = s;
+        from->instrs[from->count - 1].quad.label = s;
+    }
+    else from->fallthrough = s;
+
+    if(succ < CFG_EXIT) {
+        cfg_block *to = &f->blocks[succ];
+
+        for(unsigned e = 0; e < to->predCount; ++e) {
+            if(to->preds[e].block != pred || to->preds[e].branch != branch) continue;
+            to->preds[e].block = s;
+            to->preds[e].branch = 0;
+            break;
+        }
+    }
+
+    block->nextFunc = from->nextFunc;
+    block->nextBlock = from->nextBlock;
+    from->nextFunc = func;
+    from->nextBlock = s;
+    return s;
+}
+
+static unsigned live_count(cfg_block *b) {
+    unsigned count = 0;
+
+    for(unsigned i = 0; i < b->count; ++i) count += !b->instrs[i].dead;
+    return count;
+}
+
+/* Whether falling off the end of the block needs a jump where it is laid out */
+static int needs_jump(cfg_block *b, unsigned func) {
+    if(b->fallthrough == CFG_NONE) return 0;
+    if(b->fallthrough == CFG_EXIT) return b->nextFunc != CFG_NONE;
+    return b->nextFunc != func || b->nextBlock != b->fallthrough;
+}
+
+void cfg_lower(cfg_program *p) {
+    unsigned **start = cfg_calloc(p->funcCount, sizeof(unsigned *));
+    unsigned end = 1;
+
+    for(unsigned u = 0; u < p->funcCount; ++u)
+        start[u] = cfg_calloc(p->funcs[u].blockCount, sizeof(unsigned));
+
+    for(unsigned u = p->headFunc, b = p->headBlock; u != CFG_NONE; ) {
+        cfg_block *block = &p->funcs[u].blocks[b];
+
+        start[u][b] = end;
+        end += live_count(block) + needs_jump(block, u);
+
+        u = block->nextFunc;
+        b = block->nextBlock;
+    }
+
+    unsigned size = end + 1 > quadsSize ? end + 1 : quadsSize;
+    Quad *out = cfg_calloc(size, sizeof(Quad));
+    unsigned next = 1;
+
+    for(unsigned u = p->headFunc, b = p->headBlock; u != CFG_NONE; ) {
+        cfg_block *block = &p->funcs[u].blocks[b];
+        unsigned line = 0;
+
+        for(unsigned i = 0; i < block->count; ++i) {
+            Quad *q;
+
+            if(block->instrs[i].dead) continue;
+
+            q = &out[next++];
+            *q = block->instrs[i].quad;
+            line = q->line;
+            if(isBranch(q->op)) q->label = q->label == CFG_EXIT ? end : start[u][q->label];
+        }
+
+        if(needs_jump(block, u)) {
+            Quad *q = &out[next++];
+
+            q->op = jump;
+            q->line = line;
+            q->label = block->fallthrough == CFG_EXIT ? end : start[u][block->fallthrough];
+        }
+
+        u = block->nextFunc;
+        b = block->nextBlock;
+    }
+
+    free(quads);
+    quads = out;
+    quadsSize = size;
+    curr_quad = end;
+
+    for(unsigned u = 0; u < p->funcCount; ++u) free(start[u]);
+    free(start);
+}
+
+void cfg_free(cfg_program *p) {
+    if(!p) return;
+
+    for(unsigned u = 0; u < p->funcCount; ++u) {
+        cfg_function *f = &p->funcs[u];
+
+        for(unsigned b = 0; b < f->blockCount; ++b) {
+            cfg_block *block = &f->blocks[b];
+
+            for(unsigned i = 0; i < block->phiCount; ++i) free(block->phis[i].args);
+            free(block->phis);
+            free(block->instrs);
+            free(block->preds);
+            free(block->frontier);
+        }
+        free(f->blocks);
+        free(f->rpoOrder);
+        free(f->vars);
+        free(f->values);
+    }
+
+    free(p->funcs);
+    free(p);
+}
@@ -0,0 +1,152 @@
+#include "../headers/compile_stats.h"
+#include "../headers/quad.h"
+#include "../headers/targetcode.h"
+#include "../headers/intern.h"
+#include "../headers/peephole.h"
+#include "../headers/temp_alloc.h"
+#include "../headers/passes.h"
+#include <time.h>
+#include <sys/resource.h>
+
+extern unsigned currInstructions;
+extern unsigned currStringConst;
+extern unsigned currNumConst;
+extern unsigned currLibfunct;
+extern unsigned currUserfunct;
+extern userfunc_t *userFuncs;
+
+phase_stat phaseStats[PHASE_COUNT];
+char *phaseNames[PHASE_COUNT] = { "lex", "parse", "generate", "write" };
+
+unsigned long newtempCalls = 0;
+unsigned long newtempSymbols = 0;
+unsigned long foldedExprs = 0;
+long abcSectionBytes[ABC_SECTION_COUNT];
+
+static char *sectionNames[ABC_SECTION_COUNT] = { "header", "strings", "numbers", "libfuncs", "userfuncs", "code" };
+
+static struct timespec phaseStart;
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void phase_begin(void) {
+    clock_gettime(CLOCK_MONOTONIC, &phaseStart);
+}
+
+void phase_end(compile_phase phase) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    phaseStats[phase].seconds += (now.tv_sec - phaseStart.tv_sec) + (now.tv_nsec - phaseStart.tv_nsec) / 1e9;
+    phaseStats[phase].peakRssKb = peak_rss_kb();
+}
+
+/* One row per input: seconds and high-water RSS after every phase */
+void print_phase_times(FILE *out, char *input) {
+    fprintf(out, "%-32s", input);
+
+    for(int i = 0; i < PHASE_COUNT; i++)
+        fprintf(out, "  %s %9.4fs %8ldKB", phaseNames[i], phaseStats[i].seconds, phaseStats[i].peakRssKb);
+
+    fprintf(out, "\n");
+}
+
+static long abc_total(void) {
+    long total = 0;
+
+    for(int i = 0; i < ABC_SECTION_COUNT; i++)
+        total += abcSectionBytes[i];
+
+    return total;
+}
+
+static void print_stats_json(FILE *out) {
+    int first = 1;
+
+    fprintf(out, "{\"phases\": {");
+
+    for(int i = 0; i < PHASE_COUNT; i++) {
+        if(!phaseStats[i].peakRssKb) continue;
+
+        fprintf(out, "%s\"%s\": {\"seconds\": %.6f, \"peak_rss_kb\": %ld}",
+                first ? "" : ", ", phaseNames[i], phaseStats[i].seconds, phaseStats[i].peakRssKb);
+        first = 0;
+    }
+
+    fprintf(out, "}, \"quads\": %u, \"instructions\": %u, \"folded\": %lu, ", curr_quad - 1, currInstructions - 1, foldedExprs);
+    fprintf(out, "\"opt\": {\"level\": %d, \"passes\": [", optLevel);
+    for(unsigned i = 0, shown = 0; i < optPassCount; i++) {
+        if(!optPasses[i].ran) continue;
+        fprintf(out, "%s{\"name\": \"%s\", \"changes\": %lu}", shown++ ? ", " : "", optPasses[i].name, optPasses[i].changes);
+    }
+    fprintf(out, "]}, ");
+    fprintf(out, "\"peephole\": {\"threaded\": %lu, \"removed\": %lu}, ", jumpsThreaded, quadsRemoved);
+    fprintf(out, "\"temps\": {\"newtemp_calls\": %lu, \"symbols\": %lu, \"allocated\": %lu, \"slots\": %lu}, ",
+            newtempCalls, newtempSymbols, tempsAllocated, tempSlots);
+    fprintf(out, "\"interned\": {\"lookups\": %lu, \"strings\": %lu}, ", internLookups, internStrings);
+    fprintf(out, "\"arenas\": {\"ir\": {\"bytes\": %zu, \"reserved\": %zu, \"chunks\": %u}, "
+            "\"operands\": {\"bytes\": %zu, \"reserved\": %zu, \"chunks\": %u}}, ",
+            irArena.used, irArena.reserved, irArena.chunks,
+            operandArena.used, operandArena.reserved, operandArena.chunks);
+    fprintf(out, "\"constants\": {\"strings\": %u, \"numbers\": %u, \"libfuncs\": %u, \"userfuncs\": %u}, ",
+            currStringConst, currNumConst, currLibfunct, currUserfunct);
+
+    fprintf(out, "\"functions\": [");
+
+    for(unsigned i = 0; i < currUserfunct; i++)
+        fprintf(out, "%s{\"name\": \"%s\", \"address\": %u, \"locals\": %u}", i ? ", " : "",
+                userFuncs[i].id, userFuncs[i].address, userFuncs[i].localSize);
+
+    fprintf(out, "], \"abc\": {\"total\": %ld", abc_total());
+
+    for(int i = 0; i < ABC_SECTION_COUNT; i++)
+        fprintf(out, ", \"%s\": %ld", sectionNames[i], abcSectionBytes[i]);
+
+    fprintf(out, "}}\n");
+}
+
+static void print_stats_text(FILE *out) {
+    fprintf(out, "========== COMPILATION STATISTICS ==========\n");
+
+    for(int i = 0; i < PHASE_COUNT; i++) {
+        if(!phaseStats[i].peakRssKb) continue;
+        fprintf(out, "%-22s %.6fs (peak RSS %ld KB)\n", phaseNames[i], phaseStats[i].seconds, phaseStats[i].peakRssKb);
+    }
+
+    fprintf(out, "%-22s %u\n", "quads:", curr_quad - 1);
+    fprintf(out, "%-22s %u\n", "instructions:", currInstructions - 1);
+    fprintf(out, "%-22s %lu\n", "folded expressions:", foldedExprs);
+    fprintf(out, "%-22s -O%d", "optimization:", optLevel);
+    for(unsigned i = 0; i < optPassCount; i++)
+        if(optPasses[i].ran) fprintf(out, " %s(%lu)", optPasses[i].name, optPasses[i].changes);
+    fprintf(out, "\n");
+    fprintf(out, "%-22s %lu jumps threaded, %lu quads removed\n", "peephole:", jumpsThreaded, quadsRemoved);
+    fprintf(out, "%-22s %lu (%lu symbols)\n", "newtemp calls:", newtempCalls, newtempSymbols);
+    fprintf(out, "%-22s %lu temporaries in %lu slots\n", "temp slots:", tempsAllocated, tempSlots);
+    fprintf(out, "%-22s %lu (%lu distinct)\n", "interned strings:", internLookups, internStrings);
+    fprintf(out, "%-22s %zu bytes in %u chunks\n", "IR arena:", irArena.used, irArena.chunks);
+    fprintf(out, "%-22s %zu bytes in %u chunks\n", "operand arena:", operandArena.used, operandArena.chunks);
+    fprintf(out, "%-22s %u\n", "string constants:", currStringConst);
+    fprintf(out, "%-22s %u\n", "number constants:", currNumConst);
+    fprintf(out, "%-22s %u\n", "library functions:", currLibfunct);
+    fprintf(out, "%-22s %u\n", "user functions:", currUserfunct);
+
+    for(unsigned i = 0; i < currUserfunct; i++)
+        fprintf(out, "  %-20s %u locals (address %u)\n", userFuncs[i].id, userFuncs[i].localSize, userFuncs[i].address);
+
+    fprintf(out, "%-22s %ld bytes\n", ".abc size:", abc_total());
+
+    for(int i = 0; i < ABC_SECTION_COUNT; i++)
+        fprintf(out, "  %-20s %ld bytes\n", sectionNames[i], abcSectionBytes[i]);
+
+    fprintf(out, "============================================\n");
+}
+
+void print_compile_stats(FILE *out, int json) {
+    if(json) print_stats_json(out);
+    else print_stats_text(out);
+}
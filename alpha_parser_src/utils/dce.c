@@ -0,0 +1,54 @@
+#include "../headers/dce.h"
+#include "../headers/scope_offset_manager.h"
+
+/* The VM checks formals against the arguments passed, so touching one can fail */
+static int touches_formal(Expr *e) {
+    SymTableEntry *sym = operandVariable(e);
+    return sym && sym->space == FORMAL_SPACE;
+}
+
+static void release(cfg_function *f, unsigned value, unsigned *work, unsigned *top) {
+    if(value && --f->values[value].uses == 0) work[(*top)++] = value;
+}
+
+unsigned long eliminate_dead_code(cfg_program *p, unsigned func) {
+    cfg_function *f = &p->funcs[func];
+    unsigned *work = cfg_calloc(f->valueCount, sizeof(unsigned));
+    unsigned top = 0;
+    unsigned long removed = 0;
+
+    for(unsigned v = 1; v < f->valueCount; ++v)
+        if(!f->values[v].uses) work[top++] = v;
+
+    /* A value becomes dead once, so the worklist never holds more than every value */
+    while(top) {
+        unsigned v = work[--top];
+        ssa_value *value = &f->values[v];
+        cfg_block *block = &f->blocks[value->block];
+
+        if(value->pos == -1) {
+            for(unsigned i = 0; i < block->phiCount; ++i) {
+                cfg_phi *phi = &block->phis[i];
+
+                if(phi->value != v || phi->dead) continue;
+                phi->dead = 1;
+                for(unsigned e = 0; e < block->predCount; ++e) release(f, phi->args[e], work, &top);
+                break;
+            }
+            continue;
+        }
+
+        if(value->pos < 0) continue;
+
+        cfg_instr *instr = &block->instrs[value->pos];
+        if(instr->dead || instr->quad.op != assign) continue;
+        if(touches_formal(instr->quad.result) || touches_formal(instr->quad.arg1)) continue;
+
+        instr->dead = 1;
+        ++removed;
+        release(f, instr->value[CFG_ARG1], work, &top);
+    }
+
+    free(work);
+    return removed;
+}
@@ -0,0 +1,368 @@
+#include "../headers/gvn.h"
+#include "../headers/ssa.h"
+#include <stdint.h>
+
+enum { KEY_NONE, KEY_VALUE, KEY_VAR, KEY_NUM, KEY_STRING, KEY_BOOL, KEY_NIL, KEY_FUNC };
+
+/* An operand as far as equality goes */
+typedef struct gvn_key {
+    int kind;
+    uintptr_t id;                   /* value, symbol, string or bool */
+    double num;
+} gvn_key;
+
+typedef struct gvn_entry {
+    iopcode op;
+    gvn_key key[2];
+    unsigned value;                 /* SSA value holding the result */
+    unsigned gen;                   /* memory generation it was read in, 0 if it reads no memory */
+    unsigned bucket;
+    unsigned next;                  /* 1 + index of the next entry of the bucket, 0 ends it */
+} gvn_entry;
+
+typedef struct gvn_state {
+    cfg_function *f;
+    unsigned *buckets;
+    unsigned bucketMask;
+    gvn_entry *entries;             /* a stack: leaving a dominator subtree pops what it added */
+    unsigned entryCount, entrySize;
+    unsigned *replValue;            /* by value: the value its uses read instead, 0 if none */
+    Expr **replConst;               /* by value: the constant its uses read instead */
+    Expr **varExpr;                 /* by variable, made on demand */
+    unsigned gen, genCount;
+    unsigned long changes;
+} gvn_state;
+
+static int is_constant(Expr *e) {
+    return e && (e->type == constnum_e || e->type == conststring_e || e->type == constbool_e || e->type == nil_e);
+}
+
+static gvn_key key_of(Expr *e, unsigned value) {
+    gvn_key k = { KEY_NONE, 0, 0 };
+
+    if(!e) return k;
+    if(value) {
+        k.kind = KEY_VALUE;
+        k.id = value;
+        return k;
+    }
+
+    switch(e->type) {
+    case constnum_e:    k.kind = KEY_NUM; k.num = e->numConst; break;
+    case conststring_e: k.kind = KEY_STRING; k.id = (uintptr_t)e->strConst; break;
+    case constbool_e:   k.kind = KEY_BOOL; k.id = e->boolConst; break;
+    case nil_e:         k.kind = KEY_NIL; break;
+    case programfunc_e:
+    case libraryfunc_e: k.kind = KEY_FUNC; k.id = (uintptr_t)e->sym; break;
+    default:
+        k.kind = KEY_VAR;
+        k.id = (uintptr_t)operandVariable(e);
+        break;
+    }
+    return k;
+}
+
+static unsigned hash_key(gvn_key *k) {
+    unsigned h = (unsigned)k->kind * 31u;
+
+    if(k->kind == KEY_NUM) {
+        uint64_t bits;
+        memcpy(&bits, &k->num, sizeof(bits));
+        h ^= (unsigned)(bits ^ (bits >> 32));
+    }
+    else if(k->kind == KEY_STRING) {
+        for(const char *c = (const char *)k->id; *c; ++c) h = h * 31u + (unsigned char)*c;
+    }
+    else h ^= (unsigned)(k->id ^ ((k->id >> 16) >> 16));
+
+    return h * 2654435761u;
+}
+
+/* Numbers by bits, so that -0 and 0 stay apart */
+static int key_equal(gvn_key *a, gvn_key *b) {
+    if(a->kind != b->kind) return 0;
+    if(a->kind == KEY_NUM) return memcmp(&a->num, &b->num, sizeof(double)) == 0;
+    if(a->kind == KEY_STRING) return strcmp((const char *)a->id, (const char *)b->id) == 0;
+    return a->id == b->id;
+}
+
+static int key_before(gvn_key *a, gvn_key *b) {
+    if(a->kind != b->kind) return a->kind < b->kind;
+    if(a->kind == KEY_NUM) return memcmp(&a->num, &b->num, sizeof(double)) < 0;
+    return a->id < b->id;
+}
+
+static unsigned hash_entry(iopcode op, gvn_key key[2]) {
+    return ((unsigned)op * 0x9E3779B9u) ^ hash_key(&key[0]) ^ (hash_key(&key[1]) * 3u);
+}
+
+static gvn_entry *lookup(gvn_state *s, iopcode op, gvn_key key[2]) {
+    unsigned i = s->buckets[hash_entry(op, key) & s->bucketMask];
+
+    for(; i; i = s->entries[i - 1].next) {
+        gvn_entry *e = &s->entries[i - 1];
+
+        if(e->op != op || !key_equal(&e->key[0], &key[0]) || !key_equal(&e->key[1], &key[1])) continue;
+        if(e->gen && e->gen != s->gen) continue;
+        return e;
+    }
+    return NULL;
+}
+
+static void insert(gvn_state *s, iopcode op, gvn_key key[2], unsigned value, unsigned gen) {
+    unsigned bucket = hash_entry(op, key) & s->bucketMask;
+    gvn_entry *e;
+
+    s->entries = cfg_reserve(s->entries, s->entryCount, &s->entrySize, sizeof(gvn_entry));
+    e = &s->entries[s->entryCount++];
+    e->op = op;
+    e->key[0] = key[0];
+    e->key[1] = key[1];
+    e->value = value;
+    e->gen = gen;
+    e->bucket = bucket;
+    e->next = s->buckets[bucket];
+    s->buckets[bucket] = s->entryCount;
+}
+
+static void pop_entries(gvn_state *s, unsigned mark) {
+    while(s->entryCount > mark) {
+        gvn_entry *e = &s->entries[--s->entryCount];
+        s->buckets[e->bucket] = e->next;
+    }
+}
+
+static Expr *var_expr(gvn_state *s, unsigned value) {
+    unsigned var = s->f->values[value].var;
+
+    if(!s->varExpr[var]) s->varExpr[var] = ssa_var_expr(s->f->vars[var].sym);
+    return s->varExpr[var];
+}
+
+static unsigned resolve(gvn_state *s, unsigned value) {
+    while(value && s->replValue[value]) value = s->replValue[value];
+    return value;
+}
+
+/* The VM reads results and the table of tablegetelem without a register, and calls need something callable */
+static int takes_constant(cfg_instr *instr, int operand) {
+    if(operand == CFG_RESULT || instr->quad.op == call) return 0;
+    return !(instr->quad.op == tablegetelem && operand == CFG_ARG1);
+}
+
+static void propagate(gvn_state *s, cfg_instr *instr) {
+    cfg_function *f = s->f;
+
+    for(int k = CFG_RESULT; k <= CFG_ARG2; ++k) {
+        unsigned v = instr->value[k], w;
+
+        if(!v || cfg_defines(instr, k)) continue;
+
+        if((w = resolve(s, v)) != v) {
+            --f->values[v].uses;
+            ++f->values[w].uses;
+            instr->value[k] = w;
+            *cfg_operand(instr, k) = var_expr(s, w);
+        }
+        else if(s->replConst[v] && takes_constant(instr, k)) {
+            --f->values[v].uses;
+            instr->value[k] = 0;
+            *cfg_operand(instr, k) = s->replConst[v];
+        }
+    }
+}
+
+static int is_pure(iopcode op) {
+    switch(op) {
+    case add: case sub: case mul: case div_op: case mod_op: case uminus:
+    case tablegetelem:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void number_instr(gvn_state *s, cfg_instr *instr) {
+    cfg_function *f = s->f;
+    Quad *q = &instr->quad;
+    unsigned result = cfg_defines(instr, CFG_RESULT) ? instr->value[CFG_RESULT] : 0;
+    gvn_key key[2];
+
+    propagate(s, instr);
+    if(!result) return;
+
+    if(q->op == assign) {
+        if(instr->value[CFG_ARG1]) s->replValue[result] = instr->value[CFG_ARG1];
+        else if(is_constant(q->arg1)) s->replConst[result] = q->arg1;
+
+        if(instr->value[CFG_ARG1] || is_constant(q->arg1)) {
+            ++s->changes;
+            return;
+        }
+    }
+    else if(!is_pure(q->op)) return;
+
+    if(q->op != tablegetelem && q->op != assign && is_constant(q->arg1) && (q->op == uminus || is_constant(q->arg2))) {
+        Expr *folded = fold_arith(q->op, q->arg1, q->arg2);
+
+        if(folded && is_constant(folded)) {
+            q->op = assign;
+            q->arg1 = folded;
+            q->arg2 = NULL;
+            s->replConst[result] = folded;
+            ++s->changes;
+            return;
+        }
+    }
+
+    key[0] = key_of(q->arg1, instr->value[CFG_ARG1]);
+    key[1] = key_of(q->op == uminus || q->op == assign ? NULL : q->arg2, instr->value[CFG_ARG2]);
+    if(key[0].kind == KEY_VAR && !key[0].id) return;
+    if(key[1].kind == KEY_VAR && !key[1].id) return;
+
+    if((q->op == add || q->op == mul) && key_before(&key[1], &key[0])) {
+        gvn_key t = key[0];
+        key[0] = key[1];
+        key[1] = t;
+    }
+
+    gvn_entry *hit = lookup(s, q->op, key);
+    if(hit) {
+        s->replValue[result] = hit->value;
+        instr->dead = 1;
+        if(instr->value[CFG_ARG1]) --f->values[instr->value[CFG_ARG1]].uses;
+        if(instr->value[CFG_ARG2]) --f->values[instr->value[CFG_ARG2]].uses;
+        ++s->changes;
+        return;
+    }
+
+    /* Reads of tables and of variables outside SSA form hold only until memory may change */
+    int memory = q->op == tablegetelem || q->op == assign || key[0].kind == KEY_VAR || key[1].kind == KEY_VAR;
+    insert(s, q->op, key, result, memory ? s->gen : 0);
+}
+
+static void kill_memory(gvn_state *s, cfg_instr *instr) {
+    Quad *q = &instr->quad;
+
+    if(q->op == call || q->op == tablesetelem ||
+            (writesResult(q->op) && !instr->value[CFG_RESULT] && operandVariable(q->result)))
+        s->gen = ++s->genCount;
+}
+
+static void visit_block(gvn_state *s, unsigned b) {
+    cfg_function *f = s->f;
+    cfg_block *block = &f->blocks[b];
+
+    /* A phi whose arguments are all one value is that value */
+    for(unsigned i = 0; i < block->phiCount; ++i) {
+        cfg_phi *phi = &block->phis[i];
+        unsigned same = 0, e;
+
+        if(phi->dead) continue;
+        for(e = 0; e < block->predCount; ++e) {
+            unsigned a = resolve(s, phi->args[e]);
+
+            if(a == phi->value) continue;
+            if(same && a != same) break;
+            same = a;
+        }
+        if(e < block->predCount || !same) continue;
+
+        phi->dead = 1;
+        for(e = 0; e < block->predCount; ++e) --f->values[phi->args[e]].uses;
+        s->replValue[phi->value] = same;
+        ++s->changes;
+    }
+
+    for(unsigned j = 0; j < block->count; ++j) {
+        if(block->instrs[j].dead) continue;
+        number_instr(s, &block->instrs[j]);
+        kill_memory(s, &block->instrs[j]);
+    }
+
+    unsigned succ[2], count = cfg_successors(block, succ);
+    for(unsigned i = 0; i < count; ++i) {
+        cfg_block *to = &f->blocks[succ[i]];
+
+        for(unsigned e = 0; e < to->predCount; ++e) {
+            if(to->preds[e].block != b) continue;
+
+            for(unsigned p = 0; p < to->phiCount; ++p) {
+                unsigned a = to->phis[p].args[e], r = resolve(s, a);
+
+                if(to->phis[p].dead || r == a) continue;
+                --f->values[a].uses;
+                ++f->values[r].uses;
+                to->phis[p].args[e] = r;
+            }
+        }
+    }
+}
+
+unsigned long number_values(cfg_program *p, unsigned func) {
+    cfg_function *f = &p->funcs[func];
+    gvn_state s;
+    unsigned instrs = 0, buckets = GVN_INITIAL_BUCKETS;
+
+    if(!f->inSSA) return 0;
+
+    for(unsigned b = 0; b < f->blockCount; ++b) instrs += f->blocks[b].count;
+    while(buckets < 2 * instrs) buckets *= 2;
+
+    memset(&s, 0, sizeof(s));
+    s.f = f;
+    s.buckets = cfg_calloc(buckets, sizeof(unsigned));
+    s.bucketMask = buckets - 1;
+    s.replValue = cfg_calloc(f->valueCount, sizeof(unsigned));
+    s.replConst = cfg_calloc(f->valueCount, sizeof(Expr *));
+    s.varExpr = cfg_calloc(f->varCount, sizeof(Expr *));
+    s.gen = s.genCount = 1;
+
+    unsigned *child;
+    unsigned *children = cfg_dom_children(f, &child);
+    unsigned *fill = cfg_calloc(f->blockCount, sizeof(unsigned));
+    unsigned *stack = cfg_calloc(f->blockCount, sizeof(unsigned));
+    unsigned *mark = cfg_calloc(f->blockCount, sizeof(unsigned));
+    unsigned *genEnd = cfg_calloc(f->blockCount, sizeof(unsigned));
+    unsigned top = 0;
+
+    stack[top++] = 0;
+    mark[0] = s.entryCount;
+    visit_block(&s, 0);
+    genEnd[0] = s.gen;
+
+    while(top) {
+        unsigned b = stack[top - 1];
+
+        if(fill[b] < child[b + 1] - child[b]) {
+            unsigned c = children[child[b] + fill[b]++];
+            cfg_block *block = &f->blocks[c];
+
+            /* Memory is known on entry only when the parent is the one way in */
+            if(block->predCount == 1 && block->preds[0].block == b) s.gen = genEnd[b];
+            else s.gen = ++s.genCount;
+
+            mark[c] = s.entryCount;
+            visit_block(&s, c);
+            genEnd[c] = s.gen;
+            stack[top++] = c;
+            continue;
+        }
+
+        pop_entries(&s, mark[b]);
+        --top;
+    }
+
+    free(genEnd);
+    free(mark);
+    free(stack);
+    free(fill);
+    free(children);
+    free(child);
+    free(s.varExpr);
+    free(s.replConst);
+    free(s.replValue);
+    free(s.entries);
+    free(s.buckets);
+    return s.changes;
+}
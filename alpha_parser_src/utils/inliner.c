@@ -0,0 +1,258 @@
+#include "../headers/inliner.h"
+#include "../headers/ssa.h"
+#include "../headers/scope_offset_manager.h"
+
+typedef struct inline_callee {
+    SymTableEntry *func;
+    unsigned unit;
+    SymTableEntry *vars[INLINE_MAX_VARS];   /* each call site gets a temporary for every one */
+    unsigned varCount;
+    unsigned formals;                       /* 1 + the highest formal offset read */
+} inline_callee;
+
+static int var_index(inline_callee *c, SymTableEntry *sym) {
+    for(unsigned v = 0; v < c->varCount; ++v)
+        if(c->vars[v] == sym) return (int)v;
+    return -1;
+}
+
+static unsigned var_bit(inline_callee *c, SymTableEntry *sym) {
+    int v = sym ? var_index(c, sym) : -1;
+    return v < 0 ? 0 : 1u << v;
+}
+
+/* Formals are set by the call; every other variable of the frame starts undefined */
+static int reads_undefined(cfg_function *f, inline_callee *c) {
+    unsigned locals = 0;
+    unsigned *in = cfg_calloc(f->blockCount, sizeof(unsigned));
+    unsigned *out = cfg_calloc(f->blockCount, sizeof(unsigned));
+    int found = 0;
+
+    for(unsigned v = 0; v < c->varCount; ++v)
+        if(c->vars[v]->space != FORMAL_SPACE) locals |= 1u << v;
+
+    for(int changed = 1; changed; ) {
+        changed = 0;
+
+        for(unsigned b = 0; b < f->blockCount; ++b) {
+            cfg_block *block = &f->blocks[b];
+            unsigned maybe = b == 0 ? locals : 0;
+
+            for(unsigned e = 0; e < block->predCount; ++e) maybe |= out[block->preds[e].block];
+            in[b] = maybe;
+
+            for(unsigned j = 0; j < block->count; ++j) {
+                if(cfg_defines(&block->instrs[j], CFG_RESULT))
+                    maybe &= ~var_bit(c, operandVariable(block->instrs[j].quad.result));
+            }
+
+            if(maybe != out[b]) {
+                out[b] = maybe;
+                changed = 1;
+            }
+        }
+    }
+
+    for(unsigned b = 0; b < f->blockCount && !found; ++b) {
+        cfg_block *block = &f->blocks[b];
+        unsigned maybe = in[b];
+
+        for(unsigned j = 0; j < block->count && !found; ++j) {
+            cfg_instr *instr = &block->instrs[j];
+
+            for(int k = CFG_RESULT; k <= CFG_ARG2; ++k)
+                if(!cfg_defines(instr, k) && (maybe & var_bit(c, operandVariable(*cfg_operand(instr, k))))) found = 1;
+
+            if(cfg_defines(instr, CFG_RESULT)) maybe &= ~var_bit(c, operandVariable(instr->quad.result));
+        }
+    }
+
+    free(out);
+    free(in);
+    return found;
+}
+
+static int examine(cfg_program *p, unsigned unit, inline_callee *c) {
+    cfg_function *f = &p->funcs[unit];
+    unsigned size = 0;
+
+    memset(c, 0, sizeof(inline_callee));
+    c->func = f->func;
+    c->unit = unit;
+    if(!f->func) return 0;
+
+    for(unsigned b = 0; b < f->blockCount; ++b) {
+        for(unsigned j = 0; j < f->blocks[b].count; ++j) {
+            cfg_instr *instr = &f->blocks[b].instrs[j];
+            Quad *q = &instr->quad;
+
+            if(q->op == funcstart || q->op == funcend) continue;
+            if(++size > INLINE_MAX_QUADS) return 0;
+
+            if(q->op == call) {
+                if(!q->arg1 || q->arg1->type != libraryfunc_e) return 0;
+                if(!strcmp(q->arg1->sym->name, "totalarguments") || !strcmp(q->arg1->sym->name, "argument")) return 0;
+            }
+
+            for(int k = CFG_RESULT; k <= CFG_ARG2; ++k) {
+                SymTableEntry *sym = operandVariable(*cfg_operand(instr, k));
+
+                if(!sym || (sym->space != FORMAL_SPACE && sym->space != LOCAL_SPACE) || var_index(c, sym) >= 0) continue;
+                if(c->varCount == INLINE_MAX_VARS) return 0;
+
+                c->vars[c->varCount++] = sym;
+                if(sym->space == FORMAL_SPACE && sym->offset + 1 > c->formals) c->formals = sym->offset + 1;
+            }
+        }
+    }
+
+    return !reads_undefined(f, c);
+}
+
+static int cmp_callee(const void *a, const void *b) {
+    const inline_callee *x = a, *y = b;
+    return x->func < y->func ? -1 : x->func > y->func;
+}
+
+/*
+ * Block b is cut after the call at pos: the arguments go to the callee's
+ * formals, a copy of the callee follows, and the rest of b, starting at
+ * the getretval, becomes a block of its own after the copy.
+ */
+static void inline_site(cfg_program *p, unsigned unit, unsigned b, unsigned pos, unsigned args, inline_callee *c) {
+    cfg_function *f = &p->funcs[unit], *callee = &p->funcs[c->unit];
+    Expr *fresh[INLINE_MAX_VARS];
+    Expr **actual = cfg_calloc(args, sizeof(Expr *));
+    unsigned line = f->blocks[b].instrs[pos].quad.line;
+
+    for(unsigned v = 0; v < c->varCount; ++v) fresh[v] = ssa_var_expr(ssa_fresh_temp(f));
+    for(unsigned i = 0; i < args; ++i) actual[i] = f->blocks[b].instrs[pos - 1 - i].quad.arg1;
+
+    unsigned rest = cfg_new_block(f), base = f->blockCount;
+    for(unsigned i = 0; i < callee->blockCount; ++i) cfg_new_block(f);
+
+    cfg_block *block = &f->blocks[b], *after = &f->blocks[rest];
+
+    after->count = after->size = block->count - pos - 1;
+    after->instrs = cfg_calloc(after->size, sizeof(cfg_instr));
+    memcpy(after->instrs, &block->instrs[pos + 1], after->count * sizeof(cfg_instr));
+    after->fallthrough = block->fallthrough;
+    after->target = block->target;
+    after->nextFunc = block->nextFunc;
+    after->nextBlock = block->nextBlock;
+
+    block->count = pos - args;
+    block->fallthrough = base;
+    block->target = CFG_NONE;
+    block->nextFunc = unit;
+    block->nextBlock = base;
+
+    for(unsigned v = 0; v < c->varCount; ++v) {
+        Quad q;
+
+        if(c->vars[v]->space != FORMAL_SPACE) continue;
+
+        memset(&q, 0, sizeof(Quad));
+        q.op = assign;
+        q.result = fresh[v];
+        q.arg1 = actual[c->vars[v]->offset];
+        q.line = line;
+        cfg_insert(f, b, f->blocks[b].count, &q);
+    }
+
+    for(unsigned i = 0; i < callee->blockCount; ++i) {
+        cfg_block *from = &callee->blocks[i], *to = &f->blocks[base + i];
+        int ends = 0;
+
+        for(unsigned j = 0; j < from->count; ++j) {
+            cfg_instr copy = from->instrs[j];
+
+            if(copy.quad.op == funcstart) continue;
+            if(copy.quad.op == funcend) {
+                ends = 1;
+                continue;
+            }
+
+            for(int k = CFG_RESULT; k <= CFG_ARG2; ++k) {
+                Expr **operand = cfg_operand(&copy, k);
+                SymTableEntry *sym = operandVariable(*operand);
+                int v = sym ? var_index(c, sym) : -1;
+
+                if(v >= 0) *operand = fresh[v];
+            }
+            if(isBranch(copy.quad.op)) copy.quad.label = base + copy.quad.label;
+
+            cfg_insert(f, base + i, to->count, &copy.quad);
+        }
+
+        to->target = from->target < CFG_EXIT ? base + from->target : from->target;
+        if(ends) to->fallthrough = rest;
+        else to->fallthrough = from->fallthrough < CFG_EXIT ? base + from->fallthrough : from->fallthrough;
+
+        to->nextFunc = unit;
+        to->nextBlock = i + 1 < callee->blockCount ? base + i + 1 : rest;
+    }
+
+    free(actual);
+}
+
+/* The VM counts the pushargs right before a call, which may lie in a block falling into this one */
+static int params_before(cfg_function *f, unsigned b) {
+    cfg_block *block = &f->blocks[b];
+
+    for(unsigned e = 0; e < block->predCount; ++e) {
+        cfg_block *pred = &f->blocks[block->preds[e].block];
+        if(pred->count && pred->instrs[pred->count - 1].quad.op == param) return 1;
+    }
+    return 0;
+}
+
+unsigned long inline_calls(void) {
+    cfg_program *p = cfg_build();
+    inline_callee *callees;
+    unsigned calleeCount = 0;
+    unsigned long inlined = 0;
+
+    if(!p) return 0;
+
+    callees = cfg_calloc(p->funcCount, sizeof(inline_callee));
+    for(unsigned u = 1; u < p->funcCount; ++u)
+        if(examine(p, u, &callees[calleeCount])) ++calleeCount;
+    qsort(callees, calleeCount, sizeof(inline_callee), cmp_callee);
+
+    for(unsigned u = 0; u < p->funcCount; ++u) {
+        cfg_function *f = &p->funcs[u];
+        unsigned before = inlined;
+
+        /* The rest of a block cut at a call is a new block, reached later in this loop */
+        for(unsigned b = 0; b < f->blockCount; ++b) {
+            for(unsigned j = 0; j < f->blocks[b].count; ++j) {
+                Quad *q = &f->blocks[b].instrs[j].quad;
+                inline_callee key, *c;
+                unsigned args = 0;
+
+                if(q->op != call || !q->arg1 || q->arg1->type != programfunc_e) continue;
+
+                key.func = q->arg1->sym;
+                c = bsearch(&key, callees, calleeCount, sizeof(inline_callee), cmp_callee);
+                if(!c || c->unit == u) continue;
+
+                while(args < j && f->blocks[b].instrs[j - 1 - args].quad.op == param) ++args;
+                if(args < c->formals || (args == j && params_before(f, b))) continue;
+                if(j + 1 == f->blocks[b].count || f->blocks[b].instrs[j + 1].quad.op != getretval) continue;
+
+                inline_site(p, u, b, j, args, c);
+                ++inlined;
+                break;
+            }
+        }
+
+        if(inlined != before) cfg_link_preds(f);
+    }
+
+    /* Building the blocks left the quads alone */
+    if(inlined) cfg_lower(p);
+    cfg_free(p);
+    free(callees);
+    return inlined;
+}
@@ -0,0 +1,89 @@
+#include "../headers/intern.h"
+#include "../headers/arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Open-addressing set keyed by content; the characters live in internArena */
+typedef struct intern_slot {
+    char *str;
+    size_t len;
+    unsigned hash;
+} intern_slot;
+
+static intern_slot *slots = NULL;
+static unsigned capacity = 0;      /* power of two */
+static Arena internArena = ARENA_INIT;
+
+unsigned long internLookups = 0;
+unsigned long internStrings = 0;
+
+/* FNV-1a */
+static unsigned intern_hash(const char *s, size_t len) {
+    unsigned hash = 2166136261u;
+
+    for(size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)s[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static intern_slot *intern_probe(intern_slot *table, unsigned size, const char *s, size_t len, unsigned hash) {
+    unsigned i = hash & (size - 1);
+
+    while(table[i].str) {
+        if(table[i].hash == hash && table[i].len == len && memcmp(table[i].str, s, len) == 0) break;
+        i = (i + 1) & (size - 1);
+    }
+    return &table[i];
+}
+
+/* Keep the load factor under one half */
+static void intern_grow(void) {
+    intern_slot *old = slots;
+    unsigned oldCapacity = capacity;
+
+    capacity = capacity ? capacity * 2 : INTERN_INITIAL_SLOTS;
+    slots = calloc(capacity, sizeof(intern_slot));
+    if(!slots) {
+        fprintf(stderr, "Error: Memory allocation failed for interned strings\n");
+        exit(1);
+    }
+
+    for(unsigned i = 0; i < oldCapacity; i++)
+        if(old[i].str) *intern_probe(slots, capacity, old[i].str, old[i].len, old[i].hash) = old[i];
+
+    free(old);
+}
+
+char *intern_len(const char *s, size_t len) {
+    unsigned hash = intern_hash(s, len);
+
+    ++internLookups;
+    if(2 * (internStrings + 1) > capacity) intern_grow();
+
+    intern_slot *slot = intern_probe(slots, capacity, s, len, hash);
+    if(slot->str) return slot->str;
+
+    slot->str = arena_alloc(&internArena, len + 1);
+    memcpy(slot->str, s, len);
+    slot->str[len] = '\0';
+    slot->len = len;
+    slot->hash = hash;
+    ++internStrings;
+
+    return slot->str;
+}
+
+char *intern(const char *s) {
+    return intern_len(s, strlen(s));
+}
+
+void intern_free(void) {
+    free(slots);
+    slots = NULL;
+    capacity = 0;
+    internStrings = 0;
+    arena_free(&internArena);
+}
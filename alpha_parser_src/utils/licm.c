@@ -0,0 +1,439 @@
+#include "../headers/licm.h"
+#include "../headers/ssa.h"
+
+typedef struct licm_loop {
+    unsigned header;
+    unsigned size;                  /* blocks when found, to order the loops */
+} licm_loop;
+
+typedef struct licm_state {
+    cfg_program *p;
+    unsigned func;
+    cfg_function *f;
+    unsigned origCount;             /* blocks before any preheader was added */
+    unsigned *standIn;              /* by added block: the header it leads to */
+    unsigned *stamp;                /* by block: 1 + the loop it was last found in */
+    unsigned *body;
+    unsigned bodyCount;
+    SymTableEntry **written;        /* variables outside SSA form the loop assigns, sorted */
+    unsigned writtenCount, writtenSize;
+    int hasCall, hasTableWrite;
+    unsigned long changes;
+} licm_state;
+
+/* An added block dominates what its header dominates, as it is the one way into the loop */
+static unsigned dom_block(licm_state *s, unsigned b) {
+    return b < s->origCount ? b : s->standIn[b];
+}
+
+static int cmp_size(const void *a, const void *b) {
+    const licm_loop *x = a, *y = b;
+
+    if(x->size != y->size) return x->size < y->size ? -1 : 1;
+    return x->header < y->header ? -1 : x->header > y->header;
+}
+
+static licm_state *sortState;
+
+/* Reverse postorder, an added block right before its header */
+static int cmp_layout(const void *a, const void *b) {
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    unsigned rx = sortState->f->blocks[dom_block(sortState, x)].rpo, ry = sortState->f->blocks[dom_block(sortState, y)].rpo;
+
+    if(rx != ry) return rx < ry ? -1 : 1;
+    return (x < sortState->origCount) - (y < sortState->origCount);
+}
+
+static int cmp_sym(const void *a, const void *b) {
+    SymTableEntry *x = *(SymTableEntry * const *)a, *y = *(SymTableEntry * const *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int is_written(licm_state *s, SymTableEntry *sym) {
+    return s->writtenCount && bsearch(&sym, s->written, s->writtenCount, sizeof(SymTableEntry *), cmp_sym);
+}
+
+/* The blocks reaching a latch without passing the header, and what they may change */
+static void find_body(licm_state *s, unsigned loop, unsigned header) {
+    cfg_function *f = s->f;
+    cfg_block *h = &f->blocks[header];
+    unsigned id = loop + 1;
+
+    s->bodyCount = 0;
+    s->writtenCount = 0;
+    s->hasCall = s->hasTableWrite = 0;
+
+    s->stamp[header] = id;
+    s->body[s->bodyCount++] = header;
+    for(unsigned e = 0; e < h->predCount; ++e) {
+        unsigned latch = h->preds[e].block;
+
+        if(latch >= s->origCount || !cfg_dominates(f, header, latch) || s->stamp[latch] == id) continue;
+        s->stamp[latch] = id;
+        s->body[s->bodyCount++] = latch;
+    }
+
+    for(unsigned i = 1; i < s->bodyCount; ++i) {
+        cfg_block *block = &f->blocks[s->body[i]];
+
+        for(unsigned e = 0; e < block->predCount; ++e) {
+            unsigned pred = block->preds[e].block;
+
+            if(s->stamp[pred] == id || f->blocks[dom_block(s, pred)].rpo == CFG_NONE) continue;
+            s->stamp[pred] = id;
+            s->body[s->bodyCount++] = pred;
+        }
+    }
+
+    sortState = s;
+    qsort(s->body, s->bodyCount, sizeof(unsigned), cmp_layout);
+
+    for(unsigned i = 0; i < s->bodyCount; ++i) {
+        cfg_block *block = &f->blocks[s->body[i]];
+
+        for(unsigned j = 0; j < block->count; ++j) {
+            cfg_instr *instr = &block->instrs[j];
+            SymTableEntry *sym;
+
+            if(instr->dead) continue;
+            if(instr->quad.op == call) s->hasCall = 1;
+            if(instr->quad.op == tablesetelem) s->hasTableWrite = 1;
+
+            if(!writesResult(instr->quad.op) || instr->value[CFG_RESULT] || !(sym = operandVariable(instr->quad.result)))
+                continue;
+            s->written = cfg_reserve(s->written, s->writtenCount, &s->writtenSize, sizeof(SymTableEntry *));
+            s->written[s->writtenCount++] = sym;
+        }
+    }
+
+    qsort(s->written, s->writtenCount, sizeof(SymTableEntry *), cmp_sym);
+}
+
+/*
+ * Where the invariants of the loop go: the one block entering it when it
+ * leads nowhere else, or a new block the entering edges are moved to.
+ * Header phis with different values on those edges get a phi there.
+ */
+static unsigned make_preheader(licm_state *s, unsigned loop, unsigned header) {
+    cfg_function *f = s->f;
+    unsigned id = loop + 1, entering = 0, first = CFG_NONE;
+
+    for(unsigned e = 0; e < f->blocks[header].predCount; ++e) {
+        cfg_edge *edge = &f->blocks[header].preds[e];
+
+        if(s->stamp[edge->block] == id) continue;
+        ++entering;
+
+        /* Prefer the edge falling through from the block laid out before the header */
+        cfg_block *pred = &f->blocks[edge->block];
+        if(first == CFG_NONE || (!edge->branch && pred->nextFunc == s->func && pred->nextBlock == header)) first = e;
+    }
+    if(!entering) return CFG_NONE;
+
+    cfg_edge edge = f->blocks[header].preds[first];
+    unsigned succ[2];
+
+    if(entering == 1 && cfg_successors(&f->blocks[edge.block], succ) == 1) return edge.block;
+
+    unsigned pre = cfg_split_edge(s->p, s->func, edge.block, edge.branch);
+    cfg_block *h = &f->blocks[header], *block = &f->blocks[pre];
+    unsigned kept = 0;
+
+    s->standIn[pre] = header;
+    s->stamp[pre] = 0;
+
+    for(unsigned e = 0; e < h->predCount; ++e) {
+        cfg_edge *in = &h->preds[e];
+
+        if(e == first || s->stamp[in->block] == id) continue;
+
+        cfg_block *from = &f->blocks[in->block];
+        if(in->branch) {
+            from->target = pre;
+            from->instrs[from->count - 1].quad.label = pre;
+        }
+        else from->fallthrough = pre;
+
+        block->preds = cfg_reserve(block->preds, block->predCount, &block->predSize, sizeof(cfg_edge));
+        block->preds[block->predCount++] = *in;
+    }
+
+    for(unsigned i = 0; i < h->phiCount; ++i) {
+        cfg_phi *phi = &h->phis[i];
+        unsigned same = phi->args[first], n = 0;
+
+        for(unsigned e = 0; e < h->predCount; ++e)
+            if(e != first && s->stamp[h->preds[e].block] != id && phi->args[e] != same) same = 0;
+
+        if(same) {
+            if(!phi->dead) {
+                for(unsigned e = 0; e < h->predCount; ++e)
+                    if(e != first && s->stamp[h->preds[e].block] != id) --f->values[phi->args[e]].uses;
+            }
+            continue;
+        }
+
+        block->phis = cfg_reserve(block->phis, block->phiCount, &block->phiSize, sizeof(cfg_phi));
+        cfg_phi *merged = &block->phis[block->phiCount++];
+
+        merged->var = phi->var;
+        merged->dead = phi->dead;
+        merged->numeric = 0;
+        merged->args = cfg_calloc(block->predCount, sizeof(unsigned));
+        merged->args[n++] = phi->args[first];
+        for(unsigned e = 0; e < h->predCount; ++e)
+            if(e != first && s->stamp[h->preds[e].block] != id) merged->args[n++] = phi->args[e];
+
+        merged->value = ssa_new_value(f, phi->var, pre, -1);
+        phi->args[first] = merged->value;
+        if(!merged->dead) f->values[merged->value].uses = 1;
+    }
+
+    /* The header keeps the back edges and the one from the preheader */
+    for(unsigned e = 0; e < h->predCount; ++e) {
+        if(e != first && s->stamp[h->preds[e].block] != id) continue;
+
+        for(unsigned i = 0; i < h->phiCount; ++i) h->phis[i].args[kept] = h->phis[i].args[e];
+        h->preds[kept++] = h->preds[e];
+    }
+    h->predCount = kept;
+
+    return pre;
+}
+
+static int is_arith(iopcode op) {
+    return op == add || op == sub || op == mul || op == div_op || op == mod_op || op == uminus;
+}
+
+static cfg_instr *def_of(cfg_function *f, unsigned value) {
+    ssa_value *v = &f->values[value];
+    return v->pos >= 0 ? &f->blocks[v->block].instrs[v->pos] : NULL;
+}
+
+/* Arithmetic only ever leaves numbers behind, as the VM stops when it fails */
+static int is_number(cfg_function *f, cfg_instr *instr, int operand) {
+    Expr *e = *cfg_operand(instr, operand);
+    cfg_instr *def;
+
+    if(e && e->type == constnum_e) return 1;
+    return instr->value[operand] && (def = def_of(f, instr->value[operand])) && is_arith(def->quad.op);
+}
+
+static int cannot_fail(cfg_function *f, cfg_instr *instr) {
+    Quad *q = &instr->quad;
+    cfg_instr *def;
+
+    switch(q->op) {
+    case add: case sub: case mul:
+        return is_number(f, instr, CFG_ARG1) && is_number(f, instr, CFG_ARG2);
+    case uminus:
+        return is_number(f, instr, CFG_ARG1);
+    case div_op:
+        return is_number(f, instr, CFG_ARG1) && q->arg2->type == constnum_e && q->arg2->numConst != 0;
+    case mod_op:
+        return is_number(f, instr, CFG_ARG1) && q->arg2->type == constnum_e &&
+            q->arg2->numConst >= 1 && q->arg2->numConst < 4294967296.0;
+    case tablegetelem:
+        return instr->value[CFG_ARG1] && (def = def_of(f, instr->value[CFG_ARG1])) && def->quad.op == tablecreate;
+    default:
+        return 0;
+    }
+}
+
+/* A header phi the loop passes back unchanged: the value it has when the loop is entered */
+static cfg_phi *unchanged_phi(licm_state *s, unsigned loop, unsigned header, unsigned v) {
+    cfg_block *h = &s->f->blocks[header];
+    ssa_value *value = &s->f->values[v];
+
+    if(value->block != header || value->pos != -1) return NULL;
+
+    for(unsigned i = 0; i < h->phiCount; ++i) {
+        cfg_phi *phi = &h->phis[i];
+
+        if(phi->value != v) continue;
+        for(unsigned e = 0; e < h->predCount; ++e)
+            if(s->stamp[h->preds[e].block] == loop + 1 && phi->args[e] != v) return NULL;
+        return phi;
+    }
+    return NULL;
+}
+
+/* Values from outside the loop, constants, and variables the loop neither assigns nor can reach through a call */
+static int is_invariant(licm_state *s, unsigned loop, unsigned header, cfg_instr *instr, int operand) {
+    Expr *e = *cfg_operand(instr, operand);
+    unsigned v = instr->value[operand];
+    SymTableEntry *sym;
+
+    if(v) {
+        ssa_value *value = &s->f->values[v];
+        return value->pos == -2 || s->stamp[value->block] != loop + 1 || unchanged_phi(s, loop, header, v);
+    }
+    if(!e || !(sym = operandVariable(e))) return 1;
+    return !s->hasCall && !is_written(s, sym);
+}
+
+static int is_hoistable(iopcode op) {
+    return is_arith(op) || op == tablegetelem;
+}
+
+/* Blocks of the loop whose every way out passes through them, so they run whenever the loop is entered */
+static void find_guaranteed(licm_state *s, unsigned loop, char *guaranteed) {
+    cfg_function *f = s->f;
+    unsigned *exits = cfg_calloc(s->bodyCount, sizeof(unsigned));
+    unsigned exitCount = 0;
+
+    for(unsigned i = 0; i < s->bodyCount; ++i) {
+        unsigned succ[2], count = cfg_successors(&f->blocks[s->body[i]], succ), k;
+        cfg_block *block = &f->blocks[s->body[i]];
+
+        for(k = 0; k < count; ++k)
+            if(s->stamp[succ[k]] != loop + 1) break;
+        if(k < count || block->fallthrough == CFG_EXIT || block->target == CFG_EXIT) exits[exitCount++] = s->body[i];
+    }
+
+    for(unsigned i = 0; i < s->bodyCount; ++i) {
+        unsigned b = dom_block(s, s->body[i]), k;
+
+        for(k = 0; k < exitCount; ++k)
+            if(!cfg_dominates(f, b, exits[k])) break;
+        guaranteed[i] = exitCount && k == exitCount;
+    }
+
+    free(exits);
+}
+
+static void move_to(licm_state *s, unsigned loop, unsigned header, unsigned pre, cfg_instr *instr) {
+    cfg_function *f = s->f;
+    cfg_block *block = &f->blocks[pre], *h = &f->blocks[header];
+    unsigned pos = block->count;
+    Quad q = instr->quad;
+    unsigned value[3];
+
+    if(pos && block->instrs[pos - 1].quad.op == jump) --pos;
+
+    memcpy(value, instr->value, sizeof(value));
+
+    /* The preheader reads what an unchanged header phi gets from it */
+    for(int k = CFG_ARG1; k <= CFG_ARG2; ++k) {
+        cfg_phi *phi = value[k] ? unchanged_phi(s, loop, header, value[k]) : NULL;
+
+        if(!phi) continue;
+        for(unsigned e = 0; e < h->predCount; ++e) {
+            if(h->preds[e].block != pre) continue;
+
+            --f->values[value[k]].uses;
+            value[k] = phi->args[e];
+            ++f->values[value[k]].uses;
+            break;
+        }
+    }
+
+    instr->dead = 1;
+
+    instr = cfg_insert(f, pre, pos, &q);
+    memcpy(instr->value, value, sizeof(value));
+
+    f->values[value[CFG_RESULT]].block = pre;
+    for(unsigned j = pos; j < block->count; ++j) {
+        cfg_instr *after = &block->instrs[j];
+
+        if(!after->dead && after->value[CFG_RESULT] && cfg_defines(after, CFG_RESULT))
+            f->values[after->value[CFG_RESULT]].pos = (int)j;
+    }
+    ++s->changes;
+}
+
+static void hoist_loop(licm_state *s, unsigned loop, unsigned header) {
+    cfg_function *f = s->f;
+    unsigned pre = CFG_NONE;
+    char *guaranteed;
+    int callBefore = 0;
+
+    find_body(s, loop, header);
+    guaranteed = cfg_calloc(s->bodyCount, 1);
+    find_guaranteed(s, loop, guaranteed);
+
+    for(unsigned i = 0; i < s->bodyCount; ++i) {
+        unsigned b = s->body[i];
+
+        for(unsigned j = 0; j < f->blocks[b].count; ++j) {
+            cfg_instr *instr = &f->blocks[b].instrs[j];
+            Quad *q = &instr->quad;
+
+            if(instr->dead) continue;
+            if(q->op == call && b == header) callBefore = 1;
+
+            if(!is_hoistable(q->op) || !instr->value[CFG_RESULT]) continue;
+            if(q->op == tablegetelem && (s->hasCall || s->hasTableWrite)) continue;
+            if(!is_invariant(s, loop, header, instr, CFG_ARG1) || !is_invariant(s, loop, header, instr, CFG_ARG2)) continue;
+
+            /* What ran before it in the loop must not be visible when it fails in the preheader instead */
+            int runs = b == header ? !callBefore : guaranteed[i] && !s->hasCall;
+            if(!runs && !cannot_fail(f, instr)) continue;
+
+            if(pre == CFG_NONE && (pre = make_preheader(s, loop, header)) == CFG_NONE) {
+                free(guaranteed);
+                return;
+            }
+            move_to(s, loop, header, pre, &f->blocks[b].instrs[j]);
+        }
+    }
+
+    free(guaranteed);
+}
+
+unsigned long hoist_invariants(cfg_program *p, unsigned func) {
+    cfg_function *f = &p->funcs[func];
+    licm_loop *loops = NULL;
+    unsigned loopCount = 0, loopSize = 0;
+    licm_state s;
+
+    if(!f->inSSA) return 0;
+
+    /* A header is a block dominating one of its predecessors */
+    for(unsigned i = 0; i < f->reachable; ++i) {
+        unsigned h = f->rpoOrder[i];
+        cfg_block *block = &f->blocks[h];
+        unsigned e;
+
+        for(e = 0; e < block->predCount; ++e)
+            if(cfg_dominates(f, h, block->preds[e].block)) break;
+        if(e == block->predCount) continue;
+
+        loops = cfg_reserve(loops, loopCount, &loopSize, sizeof(licm_loop));
+        loops[loopCount].header = h;
+        loops[loopCount++].size = 0;
+    }
+    if(!loopCount) {
+        free(loops);
+        return 0;
+    }
+
+    memset(&s, 0, sizeof(s));
+    s.p = p;
+    s.func = func;
+    s.f = f;
+    s.origCount = f->blockCount;
+    s.standIn = cfg_calloc(f->blockCount + loopCount, sizeof(unsigned));
+    s.stamp = cfg_calloc(f->blockCount + loopCount, sizeof(unsigned));
+    s.body = cfg_calloc(f->blockCount + loopCount, sizeof(unsigned));
+
+    /* Nested loops are smaller than the ones around them */
+    for(unsigned l = 0; l < loopCount; ++l) {
+        find_body(&s, l, loops[l].header);
+        loops[l].size = s.bodyCount;
+    }
+    qsort(loops, loopCount, sizeof(licm_loop), cmp_size);
+
+    memset(s.stamp, 0, (f->blockCount + loopCount) * sizeof(unsigned));
+    for(unsigned l = 0; l < loopCount; ++l) hoist_loop(&s, l, loops[l].header);
+
+    if(f->blockCount > s.origCount) cfg_dominators(f);
+
+    free(s.written);
+    free(s.body);
+    free(s.stamp);
+    free(s.standIn);
+    free(loops);
+    return s.changes;
+}
@@ -0,0 +1,84 @@
+#include "../headers/passes.h"
+#include "../headers/ssa.h"
+#include "../headers/peephole.h"
+#include "../headers/temp_alloc.h"
+#include "../headers/gvn.h"
+#include "../headers/licm.h"
+#include "../headers/inliner.h"
+#include "../headers/dce.h"
+#include "../headers/type_infer.h"
+
+int optLevel = 1;
+
+static unsigned long run_peephole(void) {
+    unsigned long before = jumpsThreaded + quadsRemoved;
+
+    peephole();
+    return jumpsThreaded + quadsRemoved - before;
+}
+
+static unsigned long run_temp_alloc(void) {
+    unsigned long before = tempsAllocated;
+
+    allocate_temps();
+    return tempsAllocated - before;
+}
+
+/* SSA lowering adds jumps where blocks moved, so peephole runs again after it */
+opt_pass optPasses[] = {
+    { "peephole",   1, QUAD_PASS, run_peephole,     NULL,                0, 0 },
+    { "inline",     2, QUAD_PASS, inline_calls,     NULL,                0, 0 },
+    { "gvn",        2, SSA_PASS,  NULL,             number_values,       0, 0 },
+    { "licm",       2, SSA_PASS,  NULL,             hoist_invariants,    0, 0 },
+    { "dce",        2, SSA_PASS,  NULL,             eliminate_dead_code, 0, 0 },
+    { "types",      2, SSA_PASS,  NULL,             infer_types,         0, 0 },
+    { "peephole",   2, QUAD_PASS, run_peephole,     NULL,                0, 0 },
+    { "temp-alloc", 1, QUAD_PASS, run_temp_alloc,   NULL,                0, 0 },
+};
+
+unsigned optPassCount = sizeof(optPasses) / sizeof(optPasses[0]);
+
+/* Runs the SSA passes from first on and returns the index past them */
+static unsigned run_ssa_group(unsigned first) {
+    unsigned end = first;
+    int enabled = 0;
+
+    while(end < optPassCount && optPasses[end].kind == SSA_PASS)
+        enabled |= optPasses[end++].level <= optLevel;
+    if(!enabled) return end;
+
+    cfg_program *p = cfg_build();
+    if(!p) return end;
+
+    ssa_build(p);
+
+    for(unsigned i = first; i < end; ++i) {
+        if(optPasses[i].level > optLevel) continue;
+
+        for(unsigned u = 0; u < p->funcCount; ++u)
+            optPasses[i].changes += optPasses[i].runFunction(p, u);
+        optPasses[i].ran = 1;
+    }
+
+    ssa_destroy(p);
+    cfg_lower(p);
+    cfg_free(p);
+    return end;
+}
+
+void run_passes(void) {
+    for(unsigned i = 0; i < optPassCount; ) {
+        opt_pass *pass = &optPasses[i];
+
+        if(pass->kind == SSA_PASS) {
+            i = run_ssa_group(i);
+            continue;
+        }
+
+        if(pass->level <= optLevel) {
+            pass->changes += pass->run();
+            pass->ran = 1;
+        }
+        ++i;
+    }
+}
@@ -0,0 +1,170 @@
+#include "../headers/peephole.h"
+#include "../headers/quad.h"
+
+unsigned long jumpsThreaded = 0;
+unsigned long quadsRemoved = 0;
+
+/* Labels of unpatched jumps are 0; curr_quad is the end of the program */
+static int valid_label(unsigned label) {
+    return label > 0 && label <= curr_quad;
+}
+
+static void *peephole_alloc(size_t count, size_t size) {
+    void *p = calloc(count, size);
+    if(!p) {
+        fprintf(stderr, "Error: Memory allocation failed for peephole pass\n");
+        exit(1);
+    }
+    return p;
+}
+
+/*
+ * Point every branch past the unconditional jumps it would land on. A
+ * chain that leads back to the branch itself is an empty loop: it keeps
+ * its first hop, since the VM runs a jump to itself as a fallthrough.
+ */
+static void thread_jumps(void) {
+    for(unsigned i = 1; i < curr_quad; ++i) {
+        unsigned target = quads[i].label;
+
+        if(!isBranch(quads[i].op) || !valid_label(target)) continue;
+
+        for(unsigned hops = 0; hops < PEEPHOLE_MAX_HOPS; ++hops) {
+            if(target == curr_quad || quads[target].op != jump) break;
+            if(!valid_label(quads[target].label) || quads[target].label == target) break;
+            if(quads[target].label == i) break;
+            target = quads[target].label;
+        }
+
+        if(target != quads[i].label) {
+            quads[i].label = target;
+            ++jumpsThreaded;
+        }
+    }
+}
+
+/* Fills blockOf for quads 1..curr_quad-1 and returns the number of blocks */
+static unsigned build_blocks(basic_block **blocks, unsigned *blockOf) {
+    char *leader = peephole_alloc(curr_quad + 1, 1);
+    unsigned count = 0;
+
+    leader[1] = 1;
+    for(unsigned i = 1; i < curr_quad; ++i) {
+        if(quads[i].op == funcstart) leader[i] = 1;
+        if(isBranch(quads[i].op) || quads[i].op == funcend) {
+            leader[i + 1] = 1;
+            if(isBranch(quads[i].op) && valid_label(quads[i].label)) leader[quads[i].label] = 1;
+        }
+    }
+
+    for(unsigned i = 1; i < curr_quad; ++i) count += leader[i];
+    *blocks = peephole_alloc(count, sizeof(basic_block));
+
+    count = 0;
+    for(unsigned i = 1; i < curr_quad; ++i) {
+        if(leader[i]) (*blocks)[count++].first = i;
+        (*blocks)[count - 1].last = i;
+        blockOf[i] = count - 1;
+    }
+
+    free(leader);
+    return count;
+}
+
+/* Code is entered at quad 1 and, through calls, at every funcstart */
+static void mark_reachable(basic_block *blocks, unsigned count, unsigned *blockOf) {
+    unsigned *worklist = peephole_alloc(count, sizeof(unsigned));
+    unsigned top = 0;
+
+    for(unsigned b = 0; b < count; ++b) {
+        if(b == 0 || quads[blocks[b].first].op == funcstart) {
+            blocks[b].reachable = 1;
+            worklist[top++] = b;
+        }
+    }
+
+    while(top) {
+        unsigned b = worklist[--top];
+        Quad *last = &quads[blocks[b].last];
+        unsigned succ[2], succs = 0;
+
+        if(isBranch(last->op) && valid_label(last->label) && last->label < curr_quad)
+            succ[succs++] = blockOf[last->label];
+        if(last->op != jump && last->op != funcend && b + 1 < count)
+            succ[succs++] = b + 1;
+
+        for(unsigned s = 0; s < succs; ++s) {
+            if(blocks[succ[s]].reachable) continue;
+            blocks[succ[s]].reachable = 1;
+            worklist[top++] = succ[s];
+        }
+    }
+
+    free(worklist);
+}
+
+void peephole(void) {
+    if(curr_quad <= 1) return;
+
+    unsigned *blockOf = peephole_alloc(curr_quad + 1, sizeof(unsigned));
+    unsigned *remap = peephole_alloc(curr_quad + 1, sizeof(unsigned));
+    char *keep = peephole_alloc(curr_quad + 1, 1);
+    basic_block *blocks;
+
+    thread_jumps();
+
+    unsigned count = build_blocks(&blocks, blockOf);
+    mark_reachable(blocks, count, blockOf);
+
+    /* generate pairs funcstart with funcend, so both stay even when unreachable */
+    for(unsigned i = 1; i < curr_quad; ++i)
+        keep[i] = blocks[blockOf[i]].reachable || quads[i].op == funcstart || quads[i].op == funcend;
+
+    /*
+     * Backwards, so that nextKept is final when a jump is looked at and
+     * dropping one jump can expose the one before it. A jump onto another
+     * jump is left alone: threading only stops there when that jump leads
+     * back, and dropping this one would turn the loop into a jump to itself.
+     */
+    unsigned nextKept = curr_quad;
+    for(unsigned i = curr_quad - 1; i >= 1; --i) {
+        if(!keep[i]) continue;
+
+        if(quads[i].op == jump && valid_label(quads[i].label) && quads[i].label > i) {
+            unsigned target = quads[i].label;
+            while(target < curr_quad && !keep[target]) ++target;
+
+            if(target == nextKept && (nextKept == curr_quad || quads[nextKept].op != jump)) {
+                keep[i] = 0;
+                continue;
+            }
+        }
+        nextKept = i;
+    }
+
+    /* Removed quads take the number of the next one kept, which is where control goes instead */
+    unsigned next = 1;
+    for(unsigned i = 1; i < curr_quad; ++i)
+        if(keep[i]) remap[i] = next++;
+    remap[curr_quad] = next;
+    for(unsigned i = curr_quad - 1; i >= 1; --i)
+        if(!keep[i]) remap[i] = remap[i + 1];
+
+    next = 1;
+    for(unsigned i = 1; i < curr_quad; ++i) {
+        if(!keep[i]) continue;
+
+        quads[next] = quads[i];
+        if(isBranch(quads[next].op) && valid_label(quads[next].label))
+            quads[next].label = remap[quads[next].label];
+        ++next;
+    }
+
+    quadsRemoved += curr_quad - next;
+    curr_quad = next;
+
+    free(blocks);
+    free(keep);
+    free(remap);
+    free(blockOf);
+}
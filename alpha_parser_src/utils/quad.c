@@ -1,4 +1,8 @@
 #include "../headers/quad.h"
+#include "../headers/scope_offset_manager.h"
+#include "../headers/compile_stats.h"
+#include "../headers/passes.h"
+#include <math.h>
 
 extern unsigned yylineno;
 extern SymTable *symTable;
@@ -6,39 +10,46 @@ extern unsigned int currentScope;
 
 Quad *quads = NULL;
 unsigned quadsSize = 0;
+Arena irArena = ARENA_INIT;
 unsigned curr_quad = 0;
 unsigned int temp_counter = 0;
 unsigned int offset;
-extern int currentOffset;
+extern void updateProgramVarCount(SymTableEntry *entry);
 char labelStr[256] = "";
 
-#define EXPAND_SIZE 1024
-#define CURR_SIZE (quadsSize * sizeof(Quad))
-#define NEW_SIZE (EXPAND_SIZE * sizeof(Quad) + CURR_SIZE)
+#define INITIAL_SIZE 1024
 
 void initQuads() {
-    quads = malloc(EXPAND_SIZE * sizeof(Quad));
-    memset(quads, 0, EXPAND_SIZE * sizeof(Quad));
+    quads = calloc(INITIAL_SIZE, sizeof(Quad));
     if(!quads) {
         fprintf(stderr, "Error: Memory allocation failed for quads\n");
         exit(1);
     }
-    quadsSize = EXPAND_SIZE;
+    quadsSize = INITIAL_SIZE;
     curr_quad = 1;
     temp_counter = 0;
 }
 
 void expandQuads() {
     if(curr_quad == quadsSize) {
-        quads = realloc(quads, NEW_SIZE);
+        quads = realloc(quads, 2 * quadsSize * sizeof(Quad));
         if(!quads) {
             fprintf(stderr, "Error: Memory reallocation failed for quads\n");
             exit(1);
         }
-        quadsSize += EXPAND_SIZE;
+        quadsSize *= 2;
     }
 }
 
+/* Quads point into irArena, so both go together once the code is generated and printed */
+void freeQuads() {
+    free(quads);
+    quads = NULL;
+    quadsSize = 0;
+    curr_quad = 0;
+    arena_free(&irArena);
+}
+
 unsigned nextQuadLabel() {
     return curr_quad;
 }
@@ -47,13 +58,9 @@ void resetTemp() {
     temp_counter = 0;
 }
 
+/* Valid until the next call; the symbol table keeps its own copy */
 char *newtempname() {
-    char *name = malloc(16 * sizeof(char));
-    memset(name, 0, 16 * sizeof(char));
-    if(!name) {
-        fprintf(stderr, "Error: Memory allocation failed for temp name\n");
-        exit(1);
-    }
+    static char name[16];
     sprintf(name, "_t%u", temp_counter);
     ++temp_counter;
     return name;
@@ -61,23 +68,19 @@ char *newtempname() {
 
 SymTableEntry *newtemp() {
     char *name = newtempname();
-    SymTableEntry *tmp = SymTable_LookupAny(symTable, name);
+    SymTableEntry *tmp = SymTable_Lookup(symTable, name, currentScope);
+    ++newtempCalls;
     if(!tmp) {
-        SymbolType type = (currentScope == 0) ? GLOBAL_VAR : LOCAL_VAR;
-        tmp = SymTable_Insert(symTable, name, currentScope, 0, type);
-        tmp->offset = currentOffset++;
+        tmp = declareVariable(symTable, name, currentScope, 0);
+        if(tmp) tmp->tempId = temp_counter;
+        updateProgramVarCount(tmp);
+        ++newtempSymbols;
     }
-    free(name);
     return tmp;
 }
 
 Expr *newExpr(Expr_t type) {
-    Expr *e = malloc(sizeof(Expr));
-    if(!e) {
-        fprintf(stderr, "Error: Memory allocation failed for expression\n");
-        exit(1);
-    }
-    memset(e, 0, sizeof(Expr));
+    Expr *e = arena_alloc(&irArena, sizeof(Expr));
     e->type = type;
 
     if(type == boolexpr_e) {
@@ -99,9 +102,10 @@ Expr *newExpr_constbool(unsigned char val) {
     return e;
 }
 
+/* val must outlive the quads; lexer tokens are interned and do */
 Expr *newExpr_conststring(char *val) {
     Expr *e = newExpr(conststring_e);
-    e->strConst = strdup(val);
+    e->strConst = val;
     return e;
 }
 
@@ -128,6 +132,7 @@ void emit(iopcode op, Expr *arg1, Expr *arg2, Expr *result, unsigned label) {
     quads[curr_quad].result = result;
     quads[curr_quad].line = yylineno;
     quads[curr_quad].label = label;
+    quads[curr_quad].numeric = 0;
     curr_quad++;
 }
 
@@ -288,6 +293,156 @@ int isArithExpr(Expr *e) {
     return 1;
 }
 
+int isBranch(iopcode op) {
+    return op == jump || (op >= if_eq && op <= if_greater);
+}
+
+/* tablesetelem keeps the table in result and only reads it */
+int writesResult(iopcode op) {
+    return op != tablesetelem;
+}
+
+/* The variable behind an operand, as make_operand sees it; NULL for constants and functions */
+SymTableEntry *operandVariable(Expr *e) {
+    if(!e || !e->sym) return NULL;
+
+    switch(e->type) {
+    case var_e:
+    case tableitem_e:
+    case arithexpr_e:
+    case boolexpr_e:
+    case newtable_e:
+        return e->sym;
+    default:
+        return NULL;
+    }
+}
+
+/* Truth value of a constant as the VM's tobool would compute it; 0 if e is not a constant or at -O0 */
+int const_tobool(Expr *e, unsigned char *value) {
+    if(optLevel < 1) return 0;
+
+    switch(e->type) {
+    case constnum_e:    *value = e->numConst != 0; return 1;
+    case conststring_e: *value = e->strConst[0] != '\0'; return 1;
+    case constbool_e:   *value = e->boolConst; return 1;
+    case nil_e:         *value = 0; return 1;
+    default:            return 0;
+    }
+}
+
+/*
+ * The fold_* helpers return the value of an operation when it is known at
+ * compile time, or NULL when the VM has to compute it. They never fold an
+ * operation that would raise a runtime error, so e.g. 1 / 0 still fails
+ * when it is executed. At -O0 nothing is folded.
+ */
+Expr *fold_arith(iopcode op, Expr *e1, Expr *e2) {
+    if(optLevel < 1) return NULL;
+
+    if(op == uminus) {
+        if(e1->type != constnum_e) return NULL;
+        ++foldedExprs;
+        return newExpr_constnum(-e1->numConst);
+    }
+
+    if(e1->type == constnum_e && e2->type == constnum_e) {
+        double x = e1->numConst, y = e2->numConst, value;
+
+        switch(op) {
+        case add:    value = x + y; break;
+        case sub:    value = x - y; break;
+        case mul:    value = x * y; break;
+        case div_op:
+            if(y == 0.0) return NULL;
+            value = x / y;
+            break;
+        case mod_op:
+            /* the VM truncates both sides to unsigned; only fold where that cast is well defined */
+            if(x < 0 || y < 1 || x >= 4294967296.0 || y >= 4294967296.0) return NULL;
+            value = ((unsigned)x) % ((unsigned)y);
+            break;
+        default:
+            return NULL;
+        }
+        ++foldedExprs;
+        return newExpr_constnum(value);
+    }
+
+    /*
+     * Identities, only where the other side is the result of arithmetic and
+     * so already a number. x + 0 and x * 0 are not here: they change -0,
+     * infinities and NaN.
+     */
+    if(e1->type == arithexpr_e && e2->type == constnum_e) {
+        if(((op == mul || op == div_op) && e2->numConst == 1) || (op == sub && e2->numConst == 0)) {
+            ++foldedExprs;
+            return e1;
+        }
+    }
+    if(e2->type == arithexpr_e && e1->type == constnum_e && op == mul && e1->numConst == 1) {
+        ++foldedExprs;
+        return e2;
+    }
+
+    return NULL;
+}
+
+/* Relational operations on constants, with the VM's jeq/jne rules for mixed types */
+Expr *fold_relop(iopcode op, Expr *e1, Expr *e2) {
+    unsigned char b1, b2, value;
+
+    if(!const_tobool(e1, &b1) || !const_tobool(e2, &b2)) return NULL;
+
+    if(op == if_eq || op == if_noteq) {
+        if(e1->type == nil_e || e2->type == nil_e) value = e1->type == e2->type;
+        else if(e1->type == constbool_e || e2->type == constbool_e) value = b1 == b2;
+        else if(e1->type != e2->type) {
+            if(op == if_eq) return NULL;    /* illegal at runtime */
+            value = 0;
+        }
+        else if(e1->type == constnum_e) value = e1->numConst == e2->numConst;
+        else value = strcmp(e1->strConst, e2->strConst) == 0;
+
+        if(op == if_noteq) value = !value;
+    }
+    else {
+        if(e1->type != constnum_e || e2->type != constnum_e) return NULL;
+
+        switch(op) {
+        case if_lesseq:    value = e1->numConst <= e2->numConst; break;
+        case if_greatereq: value = e1->numConst >= e2->numConst; break;
+        case if_less:      value = e1->numConst < e2->numConst; break;
+        case if_greater:   value = e1->numConst > e2->numConst; break;
+        default:           return NULL;
+        }
+    }
+
+    ++foldedExprs;
+    return newExpr_constbool(value);
+}
+
+/* sqrt, cos and sin of a constant, computed exactly as the VM's library functions do */
+Expr *fold_libcall(Expr *func, Expr *elist) {
+    double x, value;
+
+    if(optLevel < 1 || func->type != libraryfunc_e || !func->sym || !func->sym->name) return NULL;
+    if(!elist || elist->next || elist->type != constnum_e) return NULL;
+
+    x = elist->numConst;
+
+    if(strcmp(func->sym->name, "sqrt") == 0) {
+        if(x < 0) return NULL;      /* nil at runtime */
+        value = sqrt(x);
+    }
+    else if(strcmp(func->sym->name, "cos") == 0) value = cos(x * M_PI / 180.0);
+    else if(strcmp(func->sym->name, "sin") == 0) value = sin(x * M_PI / 180.0);
+    else return NULL;
+
+    ++foldedExprs;
+    return newExpr_constnum(value);
+}
+
 void printQuads() {
     printf("%-10s %-15s %-15s %-15s %-15s %-5s\n",
            "quad#", "opcode", "result", "arg1", "arg2", "label");
@@ -335,8 +490,7 @@ void printQuads() {
 }
 
 void make_stmt(stmt_t **s) {
-    *s = malloc(sizeof(stmt_t));
-    memset(*s, 0, sizeof(stmt_t));
+    *s = arena_alloc(&irArena, sizeof(stmt_t));
     (*s)->breaklist = 0;
     (*s)->contlist = 0;
     (*s)->retlist = 0;
@@ -409,9 +563,21 @@ unsigned mergelist(unsigned l1, unsigned l2) {
 }
 
 Expr *evaluate(Expr* expr) {
+    unsigned char value;
+
     if(expr->type == boolexpr_e) return expr;
 
     Expr* result = newExpr(boolexpr_e);
+
+    /* a constant only ever takes one way out */
+    if(const_tobool(expr, &value)) {
+        if(value) result->truelist = nextQuadLabel();
+        else result->falselist = nextQuadLabel();
+
+        emit(jump, NULL, NULL, NULL, 0);
+        return result;
+    }
+
     result->truelist = nextQuadLabel();
     result->falselist = nextQuadLabel() + 1;
 
@@ -484,6 +650,9 @@ Expr *member_item(Expr* lvalue, Expr* index) {
 
 Expr *make_call(Expr *lvalue, Expr *elist) {
     Expr *func = emit_iftableitem(lvalue);
+    Expr *folded = fold_libcall(func, elist);
+
+    if(folded) return folded;
 
     Expr *reversed_elist = NULL;
     while(elist) {
@@ -513,8 +682,9 @@ Expr *handle_method_call(Expr* lvalue, FunctCont_t* callsuffix) {
         Expr *tempExpr = lvalue;
         lvalue = emit_iftableitem(member_item(lvalue, newExpr_conststring(callsuffix->name)));
 
-        while(elist && elist->next) elist = elist->next;
-        if(elist) elist->next = tempExpr;
+        /* the object is the first actual */
+        tempExpr->next = elist;
+        elist = tempExpr;
     }
     return make_call(lvalue, elist);
 }
@@ -527,9 +697,17 @@ Expr *handle_tableitem_assignment(Expr* lvalue, Expr* expr) {
     if(expr->type == boolexpr_e) expr = emit_eval_var(expr);
     emit(tablesetelem, lvalue->index, expr, table, 0);
 
+    /*
+     * The element now holds expr, so that is the value of the assignment;
+     * reading it back costs a table lookup that t[i] = x; throws away. A
+     * constant or a temporary cannot change before the value is used, but
+     * a named variable can, as in f(t.x = y, y = 1), so it is copied.
+     */
+    if(expr->type != var_e || expr->sym->tempId) return expr;
+
     Expr* result = newExpr(var_e);
     result->sym = newtemp();
-    emit(tablegetelem, table, lvalue->index, result, 0);
+    emit(assign, expr, NULL, result, 0);
 
     return result;
 }
@@ -543,7 +721,7 @@ Expr *create_table() {
 
 void add_table_element(Expr* table, unsigned index, Expr* value) {
     Expr* indexExpr = newExpr_constnum((double)index);
-    emit(tablesetelem, value, indexExpr, table, 0);
+    emit(tablesetelem, indexExpr, value, table, 0);
 }
 
 void add_indexed_element(Expr* table, Expr* index, Expr* value) {
@@ -5,6 +5,8 @@
 #include "../headers/symtable.h"
 #include "../headers/scope_offset_manager.h"
 
+/* Counts nested scope spaces: 1 is the program, then formals and locals
+ * alternate for every enclosing function (2, 3, 4, 5, ...) */
 int currentScopeSpace = PROGRAM_SPACE;
 int programOffset = 0;
 int formalOffset = 0;
@@ -21,12 +23,20 @@ void initOffsetManagement() {
     }
 }
 
+void freeOffsetManagement() {
+    int *savedOffset;
+
+    while((savedOffset = popStack(scopeOffsetStack))) free(savedOffset);
+    scopeOffsetStack = destroyStack(scopeOffsetStack);
+}
+
 int currscopespace() {
-    return currentScopeSpace;
+    if(currentScopeSpace == PROGRAM_SPACE) return PROGRAM_SPACE;
+    return (currentScopeSpace % 2 == 0) ? FORMAL_SPACE : LOCAL_SPACE;
 }
 
 int currscopeoffset() {
-    switch(currentScopeSpace) {
+    switch(currscopespace()) {
     case PROGRAM_SPACE:
         return programOffset;
     case FORMAL_SPACE:
@@ -39,7 +49,7 @@ int currscopeoffset() {
 }
 
 void inccurrscopeoffset() {
-    switch(currentScopeSpace) {
+    switch(currscopespace()) {
     case PROGRAM_SPACE:
         programOffset++;
         break;
@@ -67,7 +77,7 @@ void enterscopespace() {
 }
 
 void exitscopespace() {
-    currentScopeSpace -= 2;
+    currentScopeSpace--;
     if(currentScopeSpace < PROGRAM_SPACE) {
         currentScopeSpace = PROGRAM_SPACE;
     }
@@ -90,7 +100,7 @@ int pop_and_top() {
 }
 
 void restorecurrscopeoffset(int offset) {
-    switch(currentScopeSpace) {
+    switch(currscopespace()) {
     case PROGRAM_SPACE:
         programOffset = offset;
         break;
@@ -114,9 +124,9 @@ void assignSymbolSpaceAndOffset(SymTableEntry *sym) {
     } else if(sym->type == FORMAL) {
         space = FORMAL_SPACE;
     } else if(sym->type == LOCAL_VAR) {
-        space = (currentScopeSpace == PROGRAM_SPACE) ? PROGRAM_SPACE : LOCAL_SPACE;
+        space = (currscopespace() == PROGRAM_SPACE) ? PROGRAM_SPACE : LOCAL_SPACE;
     } else {
-        space = currentScopeSpace;
+        space = currscopespace();
     }
 
     sym->space = space;
@@ -164,9 +174,9 @@ void exitFunctionDefinition() {
 }
 
 SymbolType determineVariableType() {
-    if(currentScopeSpace == PROGRAM_SPACE) {
+    if(currscopespace() == PROGRAM_SPACE) {
         return GLOBAL_VAR;
-    } else if(currentScopeSpace == FORMAL_SPACE) {
+    } else if(currscopespace() == FORMAL_SPACE) {
         return FORMAL;
     } else {
         return LOCAL_VAR;
@@ -184,23 +194,3 @@ SymTableEntry *declareVariable(SymTable *symTable, const char *name,
 
     return sym;
 }
-
-void enterBlock() {
-    if(currscopespace() == PROGRAM_SPACE) {
-        int *savedOffset = malloc(sizeof(int));
-        *savedOffset = currscopeoffset();
-        pushStack(scopeOffsetStack, savedOffset);
-
-        restorecurrscopeoffset(0);
-    }
-}
-
-void exitBlock(int isFunctionBlock) {
-    if(currscopespace() == PROGRAM_SPACE && !isFunctionBlock) {
-        int *savedOffset = popStack(scopeOffsetStack);
-        if(savedOffset) {
-            restorecurrscopeoffset(*savedOffset);
-            free(savedOffset);
-        }
-    }
-}
\ No newline at end of file
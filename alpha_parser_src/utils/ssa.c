@@ -0,0 +1,784 @@
+#include "../headers/ssa.h"
+#include "../headers/scope_offset_manager.h"
+#include <stdint.h>
+
+extern SymTable *symTable;
+extern unsigned int programVarCount;
+
+#define SSA_SHARED UINT_MAX
+#define SSA_PHI_USE INT_MAX         /* a phi argument is read at the end of its predecessor */
+
+/* Every variable the program names, by address: the function naming it and its SSA variable there */
+typedef struct sym_slot {
+    SymTableEntry *sym;
+    unsigned func;                  /* SSA_SHARED once a second function names it */
+    unsigned var;                   /* CFG_NONE if not an SSA variable */
+} sym_slot;
+
+typedef struct sym_map {
+    sym_slot *slots;
+    unsigned capacity, count;
+} sym_map;
+
+typedef struct ssa_use {
+    unsigned value;
+    unsigned block;
+    int pos;
+} ssa_use;
+
+/* Per value, sorted by block: where it is live-out and the last position it is read at */
+typedef struct live_info {
+    unsigned *outStart, *outBlocks;
+    unsigned *useStart, *useBlocks;
+    int *usePos;
+} live_info;
+
+static unsigned hash_sym(SymTableEntry *sym) {
+    return (unsigned)(((uintptr_t)sym >> 4) * 2654435761u);
+}
+
+static sym_slot *map_find(sym_map *m, SymTableEntry *sym) {
+    if(2 * (m->count + 1) > m->capacity) {
+        sym_slot *old = m->slots;
+        unsigned oldCapacity = m->capacity;
+
+        m->capacity = m->capacity ? 2 * m->capacity : 256;
+        m->slots = cfg_calloc(m->capacity, sizeof(sym_slot));
+        for(unsigned i = 0; i < oldCapacity; ++i) {
+            if(!old[i].sym) continue;
+
+            unsigned h = hash_sym(old[i].sym) & (m->capacity - 1);
+            while(m->slots[h].sym) h = (h + 1) & (m->capacity - 1);
+            m->slots[h] = old[i];
+        }
+        free(old);
+    }
+
+    unsigned h = hash_sym(sym) & (m->capacity - 1);
+    while(m->slots[h].sym && m->slots[h].sym != sym) h = (h + 1) & (m->capacity - 1);
+
+    if(!m->slots[h].sym) {
+        m->slots[h].sym = sym;
+        m->slots[h].func = CFG_NONE;
+        m->slots[h].var = CFG_NONE;
+        ++m->count;
+    }
+    return &m->slots[h];
+}
+
+/*
+ * argument(i) reads the actuals from the caller's frame, so a function that
+ * may call it keeps its formals in memory: every store to one has to reach
+ * the slot. Only a call to a program function is known not to be argument.
+ */
+static int reads_formals(cfg_function *f) {
+    if(!f->func) return 0;
+
+    for(unsigned b = 0; b < f->blockCount; ++b) {
+        for(unsigned j = 0; j < f->blocks[b].count; ++j) {
+            Quad *q = &f->blocks[b].instrs[j].quad;
+
+            if(q->op != call || (q->arg1 && q->arg1->type == programfunc_e)) continue;
+            if(!q->arg1 || q->arg1->type != libraryfunc_e || !strcmp(q->arg1->sym->name, "argument")) return 1;
+        }
+    }
+    return 0;
+}
+
+static int is_candidate(SymTableEntry *sym, unsigned func, int formalsRead) {
+    if(func) return sym->space == LOCAL_SPACE || (sym->space == FORMAL_SPACE && !formalsRead);
+    return sym->space == PROGRAM_SPACE && sym->tempId;
+}
+
+unsigned ssa_new_value(cfg_function *f, unsigned var, unsigned block, int pos) {
+    ssa_value *v;
+
+    if(!f->valueCount) f->valueCount = 1;
+    f->values = cfg_reserve(f->values, f->valueCount, &f->valueSize, sizeof(ssa_value));
+    v = &f->values[f->valueCount];
+    memset(v, 0, sizeof(ssa_value));
+    v->var = var;
+    v->block = block;
+    v->pos = pos;
+    return f->valueCount++;
+}
+
+SymTableEntry *ssa_fresh_temp(cfg_function *f) {
+    SymTableEntry *sym;
+
+    /* A user variable may already be called _tN */
+    do sym = SymTable_Insert(symTable, newtempname(), f->scope, 0, f->func ? LOCAL_VAR : GLOBAL_VAR);
+    while(!sym);
+
+    sym->tempId = temp_counter;
+    sym->space = f->func ? LOCAL_SPACE : PROGRAM_SPACE;
+    sym->offset = f->func ? f->func->localCount++ : programVarCount++;
+    return sym;
+}
+
+Expr *ssa_var_expr(SymTableEntry *sym) {
+    Expr *e = newExpr(var_e);
+    e->sym = sym;
+    return e;
+}
+
+static void add_phi(cfg_function *f, unsigned block, unsigned var) {
+    cfg_block *b = &f->blocks[block];
+    cfg_phi *phi;
+
+    b->phis = cfg_reserve(b->phis, b->phiCount, &b->phiSize, sizeof(cfg_phi));
+    phi = &b->phis[b->phiCount++];
+    phi->var = var;
+    phi->value = 0;
+    phi->dead = 0;
+    phi->numeric = 0;
+    phi->args = cfg_calloc(b->predCount, sizeof(unsigned));
+
+    /* Edges from unreachable blocks are never renamed */
+    for(unsigned e = 0; e < b->predCount; ++e) phi->args[e] = f->vars[var].entry;
+}
+
+static void place_phis(cfg_function *f) {
+    unsigned n = f->blockCount;
+    unsigned *killed = cfg_calloc(f->varCount, sizeof(unsigned));
+    unsigned *defStart = cfg_calloc(f->varCount + 1, sizeof(unsigned));
+    unsigned *defBlocks = NULL, defCount = 0, defSize = 0;
+    unsigned *defVars = NULL, defVarSize = 0;
+
+    /* Defs by block, and which variables are read before a def in some block */
+    for(unsigned i = 0; i < f->reachable; ++i) {
+        unsigned b = f->rpoOrder[i];
+        cfg_block *block = &f->blocks[b];
+
+        for(unsigned j = 0; j < block->count; ++j) {
+            cfg_instr *instr = &block->instrs[j];
+
+            for(int k = CFG_ARG2; k >= CFG_RESULT; --k) {
+                unsigned var = instr->value[k];
+
+                if(!var || !f->vars[var - 1].sym) continue;
+                if(!cfg_defines(instr, k)) {
+                    if(killed[var - 1] != b + 1) f->vars[var - 1].global = 1;
+                    continue;
+                }
+                if(killed[var - 1] == b + 1) continue;
+
+                killed[var - 1] = b + 1;
+                defBlocks = cfg_reserve(defBlocks, defCount, &defSize, sizeof(unsigned));
+                defVars = cfg_reserve(defVars, defCount, &defVarSize, sizeof(unsigned));
+                defBlocks[defCount] = b;
+                defVars[defCount++] = var - 1;
+                ++defStart[var];
+            }
+        }
+    }
+
+    unsigned *sorted = cfg_calloc(defCount, sizeof(unsigned));
+    unsigned *fill = cfg_calloc(f->varCount, sizeof(unsigned));
+
+    for(unsigned v = 0; v < f->varCount; ++v) defStart[v + 1] += defStart[v];
+    for(unsigned d = 0; d < defCount; ++d)
+        sorted[defStart[defVars[d]] + fill[defVars[d]]++] = defBlocks[d];
+
+    unsigned *hasPhi = cfg_calloc(n, sizeof(unsigned));
+    unsigned *onWork = cfg_calloc(n, sizeof(unsigned));
+    unsigned *work = cfg_calloc(n, sizeof(unsigned));
+
+    for(unsigned v = 0; v < f->varCount; ++v) {
+        unsigned top = 0;
+
+        if(!f->vars[v].sym || !f->vars[v].global) continue;
+
+        for(unsigned d = defStart[v]; d < defStart[v + 1]; ++d) {
+            onWork[sorted[d]] = v + 1;
+            work[top++] = sorted[d];
+        }
+
+        while(top) {
+            cfg_block *x = &f->blocks[work[--top]];
+
+            for(unsigned i = 0; i < x->frontierCount; ++i) {
+                unsigned y = x->frontier[i];
+
+                if(hasPhi[y] == v + 1) continue;
+                add_phi(f, y, v);
+                hasPhi[y] = v + 1;
+
+                if(onWork[y] == v + 1) continue;
+                onWork[y] = v + 1;
+                work[top++] = y;
+            }
+        }
+    }
+
+    free(work);
+    free(onWork);
+    free(hasPhi);
+    free(fill);
+    free(sorted);
+    free(defVars);
+    free(defBlocks);
+    free(defStart);
+    free(killed);
+}
+
+/* Walks the dominator tree keeping the current value of every variable */
+static void rename_values(cfg_function *f) {
+    unsigned n = f->blockCount;
+    unsigned *current = cfg_calloc(f->varCount, sizeof(unsigned));
+    unsigned *logVar = NULL, *logPrev = NULL, logCount = 0, logSize = 0, logPrevSize = 0;
+    unsigned *child;
+    unsigned *children = cfg_dom_children(f, &child);
+    unsigned *fill = cfg_calloc(n, sizeof(unsigned));
+    unsigned *stack = cfg_calloc(n, sizeof(unsigned));
+    unsigned *mark = cfg_calloc(n, sizeof(unsigned));
+    unsigned top = 0;
+
+    for(unsigned v = 0; v < f->varCount; ++v) current[v] = f->vars[v].entry;
+
+    stack[top++] = 0;
+    mark[0] = CFG_NONE;
+    while(top) {
+        unsigned b = stack[top - 1];
+        cfg_block *block = &f->blocks[b];
+
+        if(mark[b] == CFG_NONE) {
+            mark[b] = logCount;
+
+            for(unsigned i = 0; i < block->phiCount; ++i) {
+                cfg_phi *phi = &block->phis[i];
+
+                logVar = cfg_reserve(logVar, logCount, &logSize, sizeof(unsigned));
+                logPrev = cfg_reserve(logPrev, logCount, &logPrevSize, sizeof(unsigned));
+                logVar[logCount] = phi->var;
+                logPrev[logCount++] = current[phi->var];
+                phi->value = current[phi->var] = ssa_new_value(f, phi->var, b, -1);
+            }
+
+            for(unsigned j = 0; j < block->count; ++j) {
+                cfg_instr *instr = &block->instrs[j];
+
+                for(int k = CFG_ARG2; k >= CFG_RESULT; --k) {
+                    unsigned var = instr->value[k];
+
+                    if(!var) continue;
+                    if(!f->vars[var - 1].sym) {
+                        instr->value[k] = 0;
+                        continue;
+                    }
+                    if(!cfg_defines(instr, k)) {
+                        instr->value[k] = current[var - 1];
+                        continue;
+                    }
+
+                    logVar = cfg_reserve(logVar, logCount, &logSize, sizeof(unsigned));
+                    logPrev = cfg_reserve(logPrev, logCount, &logPrevSize, sizeof(unsigned));
+                    logVar[logCount] = var - 1;
+                    logPrev[logCount++] = current[var - 1];
+                    instr->value[k] = current[var - 1] = ssa_new_value(f, var - 1, b, j);
+                }
+            }
+
+            unsigned succ[2], count = cfg_successors(block, succ);
+            for(unsigned s = 0; s < count; ++s) {
+                cfg_block *to = &f->blocks[succ[s]];
+
+                for(unsigned e = 0; e < to->predCount; ++e) {
+                    if(to->preds[e].block != b) continue;
+                    for(unsigned i = 0; i < to->phiCount; ++i)
+                        to->phis[i].args[e] = current[to->phis[i].var];
+                }
+            }
+        }
+
+        if(fill[b] < child[b + 1] - child[b]) {
+            unsigned c = children[child[b] + fill[b]++];
+            mark[c] = CFG_NONE;
+            stack[top++] = c;
+            continue;
+        }
+
+        while(logCount > mark[b]) {
+            --logCount;
+            current[logVar[logCount]] = logPrev[logCount];
+        }
+        --top;
+    }
+
+    /* Unreachable code keeps its variables as they are */
+    for(unsigned b = 0; b < n; ++b) {
+        if(f->blocks[b].rpo != CFG_NONE) continue;
+        for(unsigned j = 0; j < f->blocks[b].count; ++j)
+            memset(f->blocks[b].instrs[j].value, 0, sizeof(f->blocks[b].instrs[j].value));
+    }
+
+    free(mark);
+    free(stack);
+    free(fill);
+    free(children);
+    free(child);
+    free(logPrev);
+    free(logVar);
+    free(current);
+}
+
+static void count_uses(cfg_function *f) {
+    for(unsigned v = 1; v < f->valueCount; ++v) f->values[v].uses = 0;
+
+    for(unsigned b = 0; b < f->blockCount; ++b) {
+        cfg_block *block = &f->blocks[b];
+
+        for(unsigned i = 0; i < block->phiCount; ++i)
+            for(unsigned e = 0; e < block->predCount; ++e) ++f->values[block->phis[i].args[e]].uses;
+
+        for(unsigned j = 0; j < block->count; ++j)
+            for(int k = CFG_RESULT; k <= CFG_ARG2; ++k)
+                if(block->instrs[j].value[k] && !cfg_defines(&block->instrs[j], k))
+                    ++f->values[block->instrs[j].value[k]].uses;
+    }
+}
+
+void ssa_build(cfg_program *p) {
+    sym_map map = { NULL, 0, 0 };
+
+    /* Variables are numbered as they are first seen, so that lowering is deterministic */
+    for(unsigned u = 0; u < p->funcCount; ++u) {
+        cfg_function *f = &p->funcs[u];
+        int formalsRead = reads_formals(f);
+
+        for(unsigned b = 0; b < f->blockCount; ++b) {
+            for(unsigned j = 0; j < f->blocks[b].count; ++j) {
+                cfg_instr *instr = &f->blocks[b].instrs[j];
+
+                for(int k = CFG_RESULT; k <= CFG_ARG2; ++k) {
+                    SymTableEntry *sym = operandVariable(*cfg_operand(instr, k));
+                    sym_slot *slot;
+
+                    instr->value[k] = 0;
+                    if(!sym) continue;
+
+                    slot = map_find(&map, sym);
+                    if(slot->func == CFG_NONE) {
+                        slot->func = u;
+                        if(is_candidate(sym, u, formalsRead)) {
+                            f->vars = cfg_reserve(f->vars, f->varCount, &f->varSize, sizeof(ssa_var));
+                            f->vars[f->varCount].sym = sym;
+                            f->vars[f->varCount].global = 0;
+                            slot->var = f->varCount++;
+                        }
+                    }
+                    else if(slot->func != u && slot->func != SSA_SHARED) {
+                        if(slot->var != CFG_NONE) p->funcs[slot->func].vars[slot->var].sym = NULL;
+                        slot->func = SSA_SHARED;
+                    }
+
+                    if(slot->func == u && slot->var != CFG_NONE) instr->value[k] = slot->var + 1;
+                }
+            }
+        }
+    }
+    free(map.slots);
+
+    for(unsigned u = 0; u < p->funcCount; ++u) {
+        cfg_function *f = &p->funcs[u];
+
+        cfg_dominators(f);
+        f->valueCount = 1;
+        for(unsigned v = 0; v < f->varCount; ++v) f->vars[v].entry = ssa_new_value(f, v, 0, -2);
+
+        place_phis(f);
+        rename_values(f);
+        count_uses(f);
+        f->inSSA = 1;
+    }
+}
+
+static int cmp_unsigned(const void *a, const void *b) {
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_use(const void *a, const void *b) {
+    const ssa_use *x = a, *y = b;
+
+    if(x->block != y->block) return x->block < y->block ? -1 : 1;
+    return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+static void add_use(ssa_use **uses, unsigned *count, unsigned *size, unsigned value, unsigned block, int pos) {
+    *uses = cfg_reserve(*uses, *count, size, sizeof(ssa_use));
+    (*uses)[*count].value = value;
+    (*uses)[*count].block = block;
+    (*uses)[(*count)++].pos = pos;
+}
+
+/* Follows every use back to the def, through the predecessors */
+static void compute_liveness(cfg_function *f, live_info *live) {
+    unsigned n = f->blockCount, values = f->valueCount;
+    ssa_use *uses = NULL;
+    unsigned useCount = 0, useSize = 0;
+
+    for(unsigned i = 0; i < f->reachable; ++i) {
+        unsigned b = f->rpoOrder[i];
+        cfg_block *block = &f->blocks[b];
+
+        for(unsigned p = 0; p < block->phiCount; ++p) {
+            if(block->phis[p].dead) continue;
+            for(unsigned e = 0; e < block->predCount; ++e) {
+                if(f->blocks[block->preds[e].block].rpo == CFG_NONE) continue;
+                add_use(&uses, &useCount, &useSize, block->phis[p].args[e], block->preds[e].block, SSA_PHI_USE);
+            }
+        }
+
+        for(unsigned j = 0; j < block->count; ++j) {
+            if(block->instrs[j].dead) continue;
+            for(int k = CFG_RESULT; k <= CFG_ARG2; ++k)
+                if(block->instrs[j].value[k] && !cfg_defines(&block->instrs[j], k))
+                    add_use(&uses, &useCount, &useSize, block->instrs[j].value[k], b, j);
+        }
+    }
+
+    /* Uses by value */
+    unsigned *start = cfg_calloc(values + 1, sizeof(unsigned));
+    ssa_use *byValue = cfg_calloc(useCount, sizeof(ssa_use));
+    unsigned *fill = cfg_calloc(values, sizeof(unsigned));
+
+    for(unsigned i = 0; i < useCount; ++i) ++start[uses[i].value + 1];
+    for(unsigned v = 0; v < values; ++v) start[v + 1] += start[v];
+    for(unsigned i = 0; i < useCount; ++i) byValue[start[uses[i].value] + fill[uses[i].value]++] = uses[i];
+    free(uses);
+
+    unsigned *inStamp = cfg_calloc(n, sizeof(unsigned));
+    unsigned *outStamp = cfg_calloc(n, sizeof(unsigned));
+    unsigned *work = cfg_calloc(n, sizeof(unsigned));
+    unsigned outCount = 0, outSize = 0, usedCount = 0, usedSize = 0, posSize = 0;
+
+    live->outStart = cfg_calloc(values + 1, sizeof(unsigned));
+    live->useStart = cfg_calloc(values + 1, sizeof(unsigned));
+    live->outBlocks = NULL;
+    live->useBlocks = NULL;
+    live->usePos = NULL;
+
+    for(unsigned v = 1; v < values; ++v) {
+        ssa_value *value = &f->values[v];
+        unsigned top = 0;
+
+        live->outStart[v] = outCount;
+        live->useStart[v] = usedCount;
+
+        /* Uses come sorted by block then position, so the last one per block is the latest */
+        qsort(byValue + start[v], start[v + 1] - start[v], sizeof(ssa_use), cmp_use);
+
+        for(unsigned i = start[v]; i < start[v + 1]; ++i) {
+            ssa_use *use = &byValue[i];
+
+            if(use->pos == SSA_PHI_USE) {
+                if(outStamp[use->block] != v) {
+                    outStamp[use->block] = v;
+                    live->outBlocks = cfg_reserve(live->outBlocks, outCount, &outSize, sizeof(unsigned));
+                    live->outBlocks[outCount++] = use->block;
+                }
+            }
+            else if(i + 1 == start[v + 1] || byValue[i + 1].block != use->block || byValue[i + 1].pos == SSA_PHI_USE) {
+                live->useBlocks = cfg_reserve(live->useBlocks, usedCount, &usedSize, sizeof(unsigned));
+                live->usePos = cfg_reserve(live->usePos, usedCount, &posSize, sizeof(int));
+                live->useBlocks[usedCount] = use->block;
+                live->usePos[usedCount++] = use->pos;
+            }
+
+            if(use->block == value->block && (use->pos == SSA_PHI_USE || value->pos < use->pos)) continue;
+            if(inStamp[use->block] == v) continue;
+            inStamp[use->block] = v;
+            work[top++] = use->block;
+        }
+
+        while(top) {
+            cfg_block *block = &f->blocks[work[--top]];
+
+            for(unsigned e = 0; e < block->predCount; ++e) {
+                unsigned pred = block->preds[e].block;
+
+                if(outStamp[pred] != v) {
+                    outStamp[pred] = v;
+                    live->outBlocks = cfg_reserve(live->outBlocks, outCount, &outSize, sizeof(unsigned));
+                    live->outBlocks[outCount++] = pred;
+                }
+                if(pred == value->block || inStamp[pred] == v) continue;
+                inStamp[pred] = v;
+                work[top++] = pred;
+            }
+        }
+
+        qsort(live->outBlocks + live->outStart[v], outCount - live->outStart[v], sizeof(unsigned), cmp_unsigned);
+    }
+    live->outStart[values] = outCount;
+    live->useStart[values] = usedCount;
+
+    free(work);
+    free(outStamp);
+    free(inStamp);
+    free(fill);
+    free(byValue);
+    free(start);
+}
+
+static void free_liveness(live_info *live) {
+    free(live->outStart);
+    free(live->outBlocks);
+    free(live->useStart);
+    free(live->useBlocks);
+    free(live->usePos);
+}
+
+static int find_block(unsigned *blocks, unsigned lo, unsigned hi, unsigned block) {
+    while(lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+
+        if(blocks[mid] == block) return (int)mid;
+        if(blocks[mid] < block) lo = mid + 1;
+        else hi = mid;
+    }
+    return -1;
+}
+
+/* Whether value v is still needed right after position pos of block */
+static int live_after(live_info *live, unsigned v, unsigned block, int pos) {
+    int i;
+
+    if(find_block(live->outBlocks, live->outStart[v], live->outStart[v + 1], block) >= 0) return 1;
+
+    i = find_block(live->useBlocks, live->useStart[v], live->useStart[v + 1], block);
+    return i >= 0 && live->usePos[i] > pos;
+}
+
+static int def_dominates(cfg_function *f, ssa_value *a, ssa_value *b) {
+    if(a->block == b->block) return a->pos < b->pos;
+    return cfg_dominates(f, a->block, b->block);
+}
+
+/* In strict SSA two values interfere when one is live where the other is defined */
+static int interfere(cfg_function *f, live_info *live, unsigned a, unsigned b) {
+    ssa_value *x = &f->values[a], *y = &f->values[b];
+
+    if(def_dominates(f, x, y)) return live_after(live, a, y->block, y->pos);
+    if(def_dominates(f, y, x)) return live_after(live, b, x->block, x->pos);
+    return 0;
+}
+
+static cfg_function *sortFunc;
+
+static int cmp_def_order(const void *a, const void *b) {
+    ssa_value *x = &sortFunc->values[*(const unsigned *)a], *y = &sortFunc->values[*(const unsigned *)b];
+    unsigned px = sortFunc->blocks[x->block].domPre, py = sortFunc->blocks[y->block].domPre;
+
+    if(x->var != y->var) return x->var < y->var ? -1 : 1;
+    if(px != py) return px < py ? -1 : 1;
+    return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+typedef struct home_set {
+    SymTableEntry *sym;
+    unsigned *members;
+    unsigned count, size;
+} home_set;
+
+/*
+ * Values of one variable in dominance order, each joining the first home
+ * none of whose values it interferes with. The entry value keeps the
+ * variable itself: formals arrive there.
+ */
+static void assign_homes(cfg_function *f, live_info *live, char *defined) {
+    unsigned *order = cfg_calloc(f->valueCount, sizeof(unsigned));
+    unsigned count = 0;
+    home_set *homes = NULL;
+    unsigned homeCount = 0, homeSize = 0;
+
+    for(unsigned v = 1; v < f->valueCount; ++v)
+        if(defined[v]) order[count++] = v;
+
+    sortFunc = f;
+    qsort(order, count, sizeof(unsigned), cmp_def_order);
+
+    for(unsigned i = 0; i < count; ++i) {
+        unsigned v = order[i];
+        ssa_var *var = &f->vars[f->values[v].var];
+        unsigned h;
+
+        if(i == 0 || f->values[order[i - 1]].var != f->values[v].var) {
+            for(h = 0; h < homeCount; ++h) free(homes[h].members);
+            homeCount = 0;
+            homes = cfg_reserve(homes, homeCount, &homeSize, sizeof(home_set));
+            memset(&homes[homeCount], 0, sizeof(home_set));
+            homes[homeCount++].sym = var->sym;
+        }
+
+        for(h = 0; h < homeCount && v != var->entry; ++h) {
+            unsigned m;
+
+            for(m = 0; m < homes[h].count; ++m)
+                if(interfere(f, live, homes[h].members[m], v)) break;
+            if(m == homes[h].count) break;
+        }
+
+        if(v == var->entry) h = 0;
+        else if(h == homeCount) {
+            homes = cfg_reserve(homes, homeCount, &homeSize, sizeof(home_set));
+            memset(&homes[homeCount], 0, sizeof(home_set));
+            homes[homeCount++].sym = ssa_fresh_temp(f);
+        }
+
+        homes[h].members = cfg_reserve(homes[h].members, homes[h].count, &homes[h].size, sizeof(unsigned));
+        homes[h].members[homes[h].count++] = v;
+        f->values[v].home = homes[h].sym;
+    }
+
+    for(unsigned h = 0; h < homeCount; ++h) free(homes[h].members);
+    free(homes);
+    free(order);
+}
+
+static void insert_copy(cfg_function *f, unsigned block, unsigned *pos, SymTableEntry *dst, SymTableEntry *src, int numeric, unsigned line) {
+    Quad q;
+
+    memset(&q, 0, sizeof(Quad));
+    q.op = assign;
+    q.arg1 = ssa_var_expr(src);
+    q.result = ssa_var_expr(dst);
+    q.line = line;
+    q.numeric = numeric;
+    cfg_insert(f, block, (*pos)++, &q);
+}
+
+/* The copies of one edge happen at once: a destination still to be read is saved first */
+static void insert_parallel_copy(cfg_function *f, unsigned block, unsigned pos, SymTableEntry **dst, SymTableEntry **src, int *numeric, unsigned count, unsigned line) {
+    while(count) {
+        unsigned i, j;
+
+        for(i = 0; i < count; ++i) {
+            for(j = 0; j < count; ++j)
+                if(j != i && src[j] == dst[i]) break;
+            if(j == count) break;
+        }
+
+        if(i == count) {
+            SymTableEntry *saved = ssa_fresh_temp(f);
+            int savedNumeric = 0;
+
+            for(j = 0; j < count; ++j)
+                if(src[j] == dst[0]) savedNumeric |= numeric[j];
+
+            insert_copy(f, block, &pos, saved, dst[0], savedNumeric, line);
+            for(j = 0; j < count; ++j)
+                if(src[j] == dst[0]) src[j] = saved;
+            continue;
+        }
+
+        insert_copy(f, block, &pos, dst[i], src[i], numeric[i], line);
+        dst[i] = dst[count - 1];
+        src[i] = src[count - 1];
+        numeric[i] = numeric[count - 1];
+        --count;
+    }
+}
+
+static void lower_phis(cfg_program *p, unsigned func) {
+    cfg_function *f = &p->funcs[func];
+    unsigned blocks = f->blockCount;
+    SymTableEntry **dst = NULL, **src = NULL;
+    int *numeric = NULL;
+    unsigned dstSize = 0, srcSize = 0, numericSize = 0;
+
+    for(unsigned b = 0; b < blocks; ++b) {
+        for(unsigned e = 0; e < f->blocks[b].predCount; ++e) {
+            cfg_block *block = &f->blocks[b];
+            unsigned count = 0, line = block->count ? block->instrs[0].quad.line : 0;
+
+            for(unsigned i = 0; i < block->phiCount; ++i) {
+                cfg_phi *phi = &block->phis[i];
+                SymTableEntry *to = f->values[phi->value].home, *from = f->values[phi->args[e]].home;
+
+                if(phi->dead || to == from) continue;
+
+                dst = cfg_reserve(dst, count, &dstSize, sizeof(SymTableEntry *));
+                src = cfg_reserve(src, count, &srcSize, sizeof(SymTableEntry *));
+                numeric = cfg_reserve(numeric, count, &numericSize, sizeof(int));
+                dst[count] = to;
+                numeric[count] = phi->numeric;
+                src[count++] = from;
+            }
+            if(!count) continue;
+
+            /* Copies go before the jump of a block that only leads here; other edges get a block of their own */
+            unsigned pred = block->preds[e].block, pos;
+            cfg_block *from = &f->blocks[pred];
+            iopcode last = from->count ? from->instrs[from->count - 1].quad.op : assign;
+
+            if(!isBranch(last) || last == jump) pos = from->count - (last == jump);
+            else {
+                pred = cfg_split_edge(p, func, pred, block->preds[e].branch);
+                pos = 0;
+            }
+
+            insert_parallel_copy(f, pred, pos, dst, src, numeric, count, line);
+        }
+    }
+
+    free(numeric);
+    free(src);
+    free(dst);
+}
+
+static void destroy_function(cfg_program *p, unsigned func) {
+    cfg_function *f = &p->funcs[func];
+    char *defined = cfg_calloc(f->valueCount, 1);
+    live_info live;
+
+    for(unsigned v = 0; v < f->varCount; ++v)
+        if(f->vars[v].sym) defined[f->vars[v].entry] = 1;
+
+    for(unsigned b = 0; b < f->blockCount; ++b) {
+        cfg_block *block = &f->blocks[b];
+
+        for(unsigned i = 0; i < block->phiCount; ++i)
+            if(!block->phis[i].dead) defined[block->phis[i].value] = 1;
+
+        for(unsigned j = 0; j < block->count; ++j)
+            if(!block->instrs[j].dead && block->instrs[j].value[CFG_RESULT] && cfg_defines(&block->instrs[j], CFG_RESULT))
+                defined[block->instrs[j].value[CFG_RESULT]] = 1;
+    }
+
+    compute_liveness(f, &live);
+    assign_homes(f, &live, defined);
+    free_liveness(&live);
+
+    lower_phis(p, func);
+
+    for(unsigned b = 0; b < f->blockCount; ++b) {
+        cfg_block *block = &f->blocks[b];
+
+        for(unsigned j = 0; j < block->count; ++j) {
+            cfg_instr *instr = &block->instrs[j];
+
+            for(int k = CFG_RESULT; k <= CFG_ARG2; ++k) {
+                Expr **operand = cfg_operand(instr, k);
+                SymTableEntry *home = instr->value[k] ? f->values[instr->value[k]].home : NULL;
+
+                if(home && home != operandVariable(*operand)) *operand = ssa_var_expr(home);
+                instr->value[k] = 0;
+            }
+        }
+
+        for(unsigned i = 0; i < block->phiCount; ++i) free(block->phis[i].args);
+        block->phiCount = 0;
+    }
+
+    f->varCount = 0;
+    f->valueCount = 0;
+    f->inSSA = 0;
+    free(defined);
+}
+
+void ssa_destroy(cfg_program *p) {
+    for(unsigned u = 0; u < p->funcCount; ++u)
+        if(p->funcs[u].inSSA) destroy_function(p, u);
+}
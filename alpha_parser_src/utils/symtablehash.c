@@ -3,6 +3,7 @@
 #include <string.h>
 #include <assert.h>
 #include "../headers/symtable.h"
+#include "../headers/intern.h"
 #include "../headers/quad.h"
 #include "../headers/targetcode.h"
 
@@ -14,7 +15,58 @@ static unsigned int SymTable_hash(const char *key) {
 
     for(i = 0U; key[i] != '\0'; i++) hash = hash * hash_multi + key[i];
 
-    return hash % HASH_SIZE;
+    return hash;
+}
+
+static SymTableEntry **SymTable_bucket(SymTable *table, const char *name) {
+    return &table->buckets[SymTable_hash(name) & (table->bucketCount - 1)];
+}
+
+/* Double the bucket array once there are more active entries than buckets */
+static void SymTable_grow(SymTable *table) {
+    SymTableEntry **old = table->buckets;
+    unsigned int oldCount = table->bucketCount;
+
+    table->bucketCount *= 2;
+    table->buckets = calloc(table->bucketCount, sizeof(SymTableEntry *));
+    assert(table->buckets);
+
+    for(unsigned int i = 0; i < oldCount; i++) {
+        SymTableEntry *pCurrent = old[i];
+
+        while(pCurrent) {
+            SymTableEntry *next = pCurrent->nextLink;
+            SymTableEntry **head = SymTable_bucket(table, pCurrent->name);
+
+            pCurrent->nextLink = *head;
+            *head = pCurrent;
+            pCurrent = next;
+        }
+    }
+
+    free(old);
+}
+
+/* Make room for scope in the per-scope arrays */
+static void SymTable_reserveScope(SymTable *table, unsigned int scope) {
+    unsigned int oldCount = table->scopeCount;
+
+    if(scope < oldCount) return;
+
+    while(table->scopeCount <= scope) table->scopeCount *= 2;
+
+    table->scopeLists = realloc(table->scopeLists, table->scopeCount * sizeof(SymTableEntry *));
+    table->scopeTails = realloc(table->scopeTails, table->scopeCount * sizeof(SymTableEntry *));
+    table->scopeCursors = realloc(table->scopeCursors, table->scopeCount * sizeof(SymTableEntry *));
+    table->scopeActive = realloc(table->scopeActive, table->scopeCount * sizeof(SymTableEntry *));
+    assert(table->scopeLists && table->scopeTails && table->scopeCursors && table->scopeActive);
+
+    for(unsigned int i = oldCount; i < table->scopeCount; i++) {
+        table->scopeLists[i] = NULL;
+        table->scopeTails[i] = NULL;
+        table->scopeCursors[i] = NULL;
+        table->scopeActive[i] = NULL;
+    }
 }
 
 SymTable *SymTable_New(void) {
@@ -24,33 +76,44 @@ SymTable *SymTable_New(void) {
     assert(table);
 
     table->length = 0;
+    table->activeCount = 0;
+
+    table->bucketCount = SYMTABLE_INITIAL_BUCKETS;
+    table->buckets = calloc(table->bucketCount, sizeof(SymTableEntry *));
+    assert(table->buckets);
 
-    for(int i = 0; i < HASH_SIZE; i++) table->buckets[i] = NULL;
-    for(int i = 0; i < MAX_SCOPE; i++) table->scopeLists[i] = NULL;
+    table->scopeCount = SYMTABLE_INITIAL_SCOPES;
+    table->scopeLists = calloc(table->scopeCount, sizeof(SymTableEntry *));
+    table->scopeTails = calloc(table->scopeCount, sizeof(SymTableEntry *));
+    table->scopeCursors = calloc(table->scopeCount, sizeof(SymTableEntry *));
+    table->scopeActive = calloc(table->scopeCount, sizeof(SymTableEntry *));
+    assert(table->scopeLists && table->scopeTails && table->scopeCursors && table->scopeActive);
 
     return table;
 }
 
 void SymTable_Free(SymTable *table) {
 
-    Binding *pCurrent;
-    int index;
+    SymTableEntry *pCurrent;
 
     assert(table);
 
-    for(index = 0; index < HASH_SIZE; index++) {
-        pCurrent = table->buckets[index];
+    for(unsigned int s = 0; s < table->scopeCount; s++) {
+        pCurrent = table->scopeLists[s];
 
         while(pCurrent) {
-            Binding *next = pCurrent->next;
-            free((void *)pCurrent->key);
-            free((void *)pCurrent->entry->name);
-            free((void *)pCurrent->entry);
-            free(pCurrent);
+            SymTableEntry *next = pCurrent->nextInScope;
+            free((void *)pCurrent);
             pCurrent = next;
         }
     }
 
+    free(table->buckets);
+    free(table->scopeLists);
+    free(table->scopeTails);
+    free(table->scopeCursors);
+    free(table->scopeActive);
+
     table->length = 0;
     free(table);
 }
@@ -64,21 +127,20 @@ unsigned int SymTable_getLength(SymTable *table) {
 
 SymTableEntry *SymTable_Insert(SymTable *table, const char *name, unsigned int scope, unsigned int line, SymbolType type) {
 
-    SymTableEntry *existing;
     SymTableEntry *entry;
-    Binding *pNewBinding;
 
     assert(table);
     assert(name);
 
-    existing = SymTable_Lookup(table, name, scope);
-    if(existing && existing->isActive) return NULL;
+    if(SymTable_Lookup(table, name, scope)) return NULL;
+
+    SymTable_reserveScope(table, scope);
 
     entry = malloc(sizeof(SymTableEntry));
     assert(entry);
 
-    entry->name = strdup(name);
-    assert(entry->name);
+    /* Identifiers from the lexer are already interned, so this only finds them */
+    entry->name = intern(name);
 
     entry->scope = scope;
     entry->line = line;
@@ -86,46 +148,43 @@ SymTableEntry *SymTable_Insert(SymTable *table, const char *name, unsigned int s
     entry->space = 0;
     entry->localCount = 0;
     entry->taddress = 0;
+    entry->tempId = 0;
     entry->isActive = 1;
     entry->type = type;
     entry->nextInScope = NULL;
 
+    /* Sources are parsed top to bottom, so the entry almost always goes last;
+       temporaries all carry line 0 and go right after the previous out-of-order one */
     SymTableEntry **scopeHead = &table->scopeLists[scope];
-    if(*scopeHead == NULL || (*scopeHead)->line > line) {
+    SymTableEntry **scopeTail = &table->scopeTails[scope];
+    SymTableEntry *cursor = table->scopeCursors[scope];
+
+    if(*scopeHead == NULL) {
+        *scopeHead = *scopeTail = entry;
+    } else if((*scopeTail)->line <= line) {
+        (*scopeTail)->nextInScope = entry;
+        *scopeTail = entry;
+    } else if((*scopeHead)->line > line) {
         entry->nextInScope = *scopeHead;
-        *scopeHead = entry;
+        *scopeHead = table->scopeCursors[scope] = entry;
     } else {
-        SymTableEntry *curr = *scopeHead;
+        SymTableEntry *curr = cursor && cursor->line <= line ? cursor : *scopeHead;
         while(curr->nextInScope && curr->nextInScope->line <= line) curr = curr->nextInScope;
 
         entry->nextInScope = curr->nextInScope;
-        curr->nextInScope = entry;
+        curr->nextInScope = table->scopeCursors[scope] = entry;
     }
 
-    pNewBinding = malloc(sizeof(Binding));
-    assert(pNewBinding);
-
-    pNewBinding->key = strdup(name);
-    assert(pNewBinding->key);
-
-    pNewBinding->entry = entry;
-    pNewBinding->next = NULL;
+    entry->nextActive = table->scopeActive[scope];
+    table->scopeActive[scope] = entry;
 
-    unsigned int index = SymTable_hash(name);
-    Binding **bucketHead = &table->buckets[index];
-
-    if(*bucketHead == NULL || (*bucketHead)->entry->line > line) {
-        pNewBinding->next = *bucketHead;
-        *bucketHead = pNewBinding;
-    } else {
-        Binding *curr = *bucketHead;
-        while(curr->next && curr->next->entry->line <= line) curr = curr->next;
-
-        pNewBinding->next = curr->next;
-        curr->next = pNewBinding;
-    }
+    SymTableEntry **bucketHead = SymTable_bucket(table, name);
+    entry->nextLink = *bucketHead;
+    *bucketHead = entry;
 
     table->length++;
+    if(++table->activeCount > table->bucketCount) SymTable_grow(table);
+
     return entry;
 }
 
@@ -137,29 +196,29 @@ SymTableEntry *SymTable_Lookup(SymTable *table, const char *name, unsigned int s
     assert(table);
     assert(name);
 
-    pCurrent = table->scopeLists[scope];
+    pCurrent = *SymTable_bucket(table, name);
     while(pCurrent) {
-        if(pCurrent->isActive && strcmp(pCurrent->name, name) == 0) return pCurrent;
-        pCurrent = pCurrent->nextInScope;
+        if(pCurrent->scope == scope && (pCurrent->name == name || strcmp(pCurrent->name, name) == 0)) return pCurrent;
+        pCurrent = pCurrent->nextLink;
     }
     return NULL;
 }
 
+/* Innermost active entry: buckets only hold active entries, one per open scope at most */
 SymTableEntry *SymTable_LookupAny(SymTable *table, const char *name) {
 
-    SymTableEntry *pCurrent;
+    SymTableEntry *pCurrent, *pFound = NULL;
 
     assert(table);
     assert(name);
 
-    for(int s = MAX_SCOPE - 1; s >= 0; s--) {
-        pCurrent = table->scopeLists[s];
-        while(pCurrent) {
-            if(pCurrent->isActive && strcmp(pCurrent->name, name) == 0) return pCurrent;
-            pCurrent = pCurrent->nextInScope;
-        }
+    pCurrent = *SymTable_bucket(table, name);
+    while(pCurrent) {
+        if((pCurrent->name == name || strcmp(pCurrent->name, name) == 0) && (!pFound || pCurrent->scope > pFound->scope))
+            pFound = pCurrent;
+        pCurrent = pCurrent->nextLink;
     }
-    return NULL;
+    return pFound;
 }
 
 void SymTable_Hide(SymTable *table, unsigned int scope) {
@@ -167,13 +226,23 @@ void SymTable_Hide(SymTable *table, unsigned int scope) {
     SymTableEntry *pCurrent;
 
     assert(table);
-    if(scope == 0) return;
+    if(scope == 0 || scope >= table->scopeCount) return;
 
-    pCurrent = table->scopeLists[scope];
+    pCurrent = table->scopeActive[scope];
     while(pCurrent) {
+        SymTableEntry **link = SymTable_bucket(table, pCurrent->name);
+
+        while(*link != pCurrent) link = &(*link)->nextLink;
+        *link = pCurrent->nextLink;
+
         pCurrent->isActive = 0;
-        pCurrent = pCurrent->nextInScope;
+        pCurrent->nextLink = NULL;
+        table->activeCount--;
+
+        pCurrent = pCurrent->nextActive;
     }
+
+    table->scopeActive[scope] = NULL;
 }
 
 SymTable *SymTable_Initialize(void) {
@@ -181,10 +250,11 @@ SymTable *SymTable_Initialize(void) {
 
     const char *libfuncs[] = {
         "print", "input", "objectmemberkeys", "objecttotalmembers", "objectcopy",
-        "totalarguments", "argument", "typeof", "strtonum", "sqrt", "cos", "sin"
+        "totalarguments", "argument", "typeof", "strtonum", "sqrt", "cos", "sin",
+        "vmstats", "heapdump", "tracedump"
     };
 
-    for(int i = 0; i < 12; i++) {
+    for(size_t i = 0; i < sizeof(libfuncs) / sizeof(libfuncs[0]); i++) {
         SymTableEntry *entry = SymTable_Insert(table, libfuncs[i], 0, 0, LIBFUNC);
         if(entry) entry->offset = 0;
     }
@@ -193,7 +263,7 @@ SymTable *SymTable_Initialize(void) {
 }
 
 void SymTable_Print(SymTable *table) {
-    for(int s = 0; s < MAX_SCOPE; s++) {
+    for(unsigned int s = 0; s < table->scopeCount; s++) {
         SymTableEntry *curr = table->scopeLists[s];
         if(!curr) continue;
 
@@ -2,10 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
 #include "../headers/targetcode.h"
 #include "../headers/quad.h"
 #include "../headers/symtable.h"
 #include "../headers/stack.h"
+#include "../headers/compile_stats.h"
 
 extern unsigned int programVarCount;
 
@@ -32,9 +34,32 @@ unsigned currUserfunct = 0;
 
 static Stack *funcStack = NULL;
 
-#define EXPAND_SIZE 1024
-#define CURR_SIZE (instructionsSize * sizeof(instruction))
-#define NEW_SIZE (EXPAND_SIZE * sizeof(instruction) + CURR_SIZE)
+Arena operandArena = ARENA_INIT;
+
+/* Open-addressing index over one constant pool; slots hold pool index + 1, 0 is empty */
+typedef struct const_index {
+    unsigned *slots;
+    unsigned capacity;      /* power of two */
+    unsigned count;
+    unsigned (*hash)(unsigned poolIndex);
+} const_index;
+
+static unsigned hash_string(const char *s);
+static unsigned hash_number(double n);
+static unsigned hash_userfunc(unsigned address, const char *id);
+static void index_reset(const_index *idx);
+
+static unsigned stringHash(unsigned i)   { return hash_string(stringConsts[i]); }
+static unsigned numberHash(unsigned i)   { return hash_number(numConsts[i]); }
+static unsigned libfuncHash(unsigned i)  { return hash_string(libFuncs[i]); }
+static unsigned userfuncHash(unsigned i) { return hash_userfunc(userFuncs[i].address, userFuncs[i].id); }
+
+static const_index stringIndex   = { NULL, 0, 0, stringHash };
+static const_index numberIndex   = { NULL, 0, 0, numberHash };
+static const_index libfuncIndex  = { NULL, 0, 0, libfuncHash };
+static const_index userfuncIndex = { NULL, 0, 0, userfuncHash };
+
+#define INITIAL_SIZE 1024
 
 unsigned nextinstructionlabel() {
     return currInstructions;
@@ -69,116 +94,204 @@ generator_func_t generators[] = {
     generate_TABLESETELEM
 };
 
-instruction *mallocInstr() {
-    instruction *instr = malloc(sizeof(instruction));
-    assert(instr != NULL);
+/* Scratch instruction for one generator; its operands go straight into the arena
+   and are kept by emit_tcode, so nothing is copied or freed per instruction */
+static instruction *newInstr(Quad *quad) {
+    static instruction instr;
+    vmarg *args = arena_alloc(&operandArena, 3 * sizeof(vmarg));
 
-    instr->arg1 = malloc(sizeof(vmarg));
-    instr->arg2 = malloc(sizeof(vmarg));
-    instr->result = malloc(sizeof(vmarg));
-    assert(instr->arg1 != NULL && instr->arg2 != NULL && instr->result != NULL);
+    instr.opcode = nop_v;
+    instr.srcLine = quad ? quad->line : 0;
+    instr.result = &args[0];
+    instr.arg1 = &args[1];
+    instr.arg2 = &args[2];
 
-    instr->arg1->type = nil_a;
-    instr->arg1->val = 0;
-    instr->arg2->type = nil_a;
-    instr->arg2->val = 0;
-    instr->result->type = nil_a;
-    instr->result->val = 0;
+    for(int i = 0; i < 3; i++) args[i].type = nil_a;
 
-    return instr;
-}
-void freeInstr(instruction *instr) {
-    if(instr->arg1) free(instr->arg1);
-    if(instr->arg2) free(instr->arg2);
-    if(instr->result) free(instr->result);
-    free(instr);
+    return &instr;
 }
 
 void initInstructions() {
-    instructions = malloc(EXPAND_SIZE * sizeof(instruction));
+    instructions = calloc(INITIAL_SIZE, sizeof(instruction));
     assert(instructions);
-    memset(instructions, 0, EXPAND_SIZE * sizeof(instruction));
-    instructionsSize = EXPAND_SIZE;
+    instructionsSize = INITIAL_SIZE;
     currInstructions = 1;
 
-    numConsts = malloc(EXPAND_SIZE * sizeof(double));
+    numConsts = malloc(INITIAL_SIZE * sizeof(double));
     assert(numConsts);
-    totalNumConsts = EXPAND_SIZE;
+    totalNumConsts = INITIAL_SIZE;
     currNumConst = 0;
 
-    stringConsts = malloc(EXPAND_SIZE * sizeof(char*));
+    stringConsts = malloc(INITIAL_SIZE * sizeof(char*));
     assert(stringConsts);
-    totalStringConsts = EXPAND_SIZE;
+    totalStringConsts = INITIAL_SIZE;
     currStringConst = 0;
 
-    libFuncs = malloc(EXPAND_SIZE * sizeof(char*));
+    libFuncs = malloc(INITIAL_SIZE * sizeof(char*));
     assert(libFuncs);
-    totalNameLibfuncs = EXPAND_SIZE;
+    totalNameLibfuncs = INITIAL_SIZE;
     currLibfunct = 0;
 
-    userFuncs = malloc(EXPAND_SIZE * sizeof(userfunc_t));
+    userFuncs = malloc(INITIAL_SIZE * sizeof(userfunc_t));
     assert(userFuncs);
-    totalUserFuncs = EXPAND_SIZE;
+    totalUserFuncs = INITIAL_SIZE;
     currUserfunct = 0;
     funcStack = newStack();
+
+    index_reset(&stringIndex);
+    index_reset(&numberIndex);
+    index_reset(&libfuncIndex);
+    index_reset(&userfuncIndex);
+}
+
+void freeInstructions() {
+    for(unsigned i = 0; i < currStringConst; i++) free(stringConsts[i]);
+    for(unsigned i = 0; i < currLibfunct; i++) free(libFuncs[i]);
+    for(unsigned i = 0; i < currUserfunct; i++) free(userFuncs[i].id);
+
+    free(instructions);
+    free(numConsts);
+    free(stringConsts);
+    free(libFuncs);
+    free(userFuncs);
+    instructions = NULL;
+    numConsts = NULL;
+    stringConsts = NULL;
+    libFuncs = NULL;
+    userFuncs = NULL;
+    currInstructions = currNumConst = currStringConst = currLibfunct = currUserfunct = 0;
+
+    free(stringIndex.slots);
+    free(numberIndex.slots);
+    free(libfuncIndex.slots);
+    free(userfuncIndex.slots);
+    stringIndex.slots = numberIndex.slots = libfuncIndex.slots = userfuncIndex.slots = NULL;
+
+    funcStack = destroyStack(funcStack);
+    arena_free(&operandArena);
 }
 
 void expandNum() {
     assert(totalNumConsts == currNumConst);
-    numConsts = realloc(numConsts, (totalNumConsts + EXPAND_SIZE) * sizeof(double));
+    numConsts = realloc(numConsts, 2 * totalNumConsts * sizeof(double));
     if(!numConsts) {
         fprintf(stderr, "Error: Memory allocation failed for numeric constants\n");
         exit(1);
     }
-    totalNumConsts += EXPAND_SIZE;
+    totalNumConsts *= 2;
 }
 void expandString() {
     assert(totalStringConsts == currStringConst);
 
-    stringConsts = realloc(stringConsts, (totalStringConsts + EXPAND_SIZE) * sizeof(char*));
+    stringConsts = realloc(stringConsts, 2 * totalStringConsts * sizeof(char*));
     if(!stringConsts) {
         fprintf(stderr, "Error: Memory allocation failed for string constants\n");
         exit(1);
     }
-    totalStringConsts += EXPAND_SIZE;
+    totalStringConsts *= 2;
 }
 void expandUserfunc() {
     assert(totalUserFuncs == currUserfunct);
 
-    userFuncs = realloc(userFuncs, (totalUserFuncs + EXPAND_SIZE) * sizeof(userfunc_t));
+    userFuncs = realloc(userFuncs, 2 * totalUserFuncs * sizeof(userfunc_t));
     if(!userFuncs) {
         fprintf(stderr, "Error: Memory allocation failed for user functions\n");
         exit(1);
     }
-    totalUserFuncs += EXPAND_SIZE;
+    totalUserFuncs *= 2;
 }
 void expandLibfunc() {
     assert(totalNameLibfuncs == currLibfunct);
 
-    libFuncs = realloc(libFuncs, (totalNameLibfuncs + EXPAND_SIZE) * sizeof(char*));
+    libFuncs = realloc(libFuncs, 2 * totalNameLibfuncs * sizeof(char*));
     if(!libFuncs) {
         fprintf(stderr, "Error: Memory allocation failed for library functions\n");
         exit(1);
     }
-    totalNameLibfuncs += EXPAND_SIZE;
+    totalNameLibfuncs *= 2;
 }
 void expandInstructions() {
     if(currInstructions == instructionsSize) {
-        instructions = realloc(instructions, NEW_SIZE);
+        instructions = realloc(instructions, 2 * instructionsSize * sizeof(instruction));
         if(!instructions) {
             fprintf(stderr, "Error: Memory allocation failed for instructions\n");
             exit(1);
         }
-        instructionsSize += EXPAND_SIZE;
+        instructionsSize *= 2;
     }
 }
 
-unsigned consts_newString(char *s) {
-    for(unsigned i = 0; i < currStringConst; i++) {
-        if(strcmp(stringConsts[i], s) == 0) {
-            return i;
-        }
+/* FNV-1a */
+static unsigned hash_string(const char *s) {
+    unsigned hash = 2166136261u;
+
+    while(*s) {
+        hash ^= (unsigned char)*s++;
+        hash *= 16777619u;
     }
+    return hash;
+}
+
+/* Keyed on the bit pattern, so -0.0 and 0.0 get separate entries */
+static unsigned hash_number(double n) {
+    uint64_t bits;
+    memcpy(&bits, &n, sizeof(bits));
+
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return (unsigned)bits;
+}
+
+static unsigned hash_userfunc(unsigned address, const char *id) {
+    return hash_string(id) ^ (address * 2654435761u);
+}
+
+static void index_reset(const_index *idx) {
+    free(idx->slots);
+    idx->capacity = 64;
+    idx->count = 0;
+    idx->slots = calloc(idx->capacity, sizeof(unsigned));
+    assert(idx->slots);
+}
+
+static void index_grow(const_index *idx) {
+    unsigned *old = idx->slots;
+    unsigned oldCapacity = idx->capacity;
+
+    idx->capacity *= 2;
+    idx->slots = calloc(idx->capacity, sizeof(unsigned));
+    assert(idx->slots);
+
+    for(unsigned i = 0; i < oldCapacity; i++) {
+        if(!old[i]) continue;
+
+        unsigned pos = idx->hash(old[i] - 1) & (idx->capacity - 1);
+        while(idx->slots[pos]) pos = (pos + 1) & (idx->capacity - 1);
+        idx->slots[pos] = old[i];
+    }
+
+    free(old);
+}
+
+/* Slot at the given step of the linear probe for hash; callers stop at a match or an empty slot */
+static unsigned *index_probe(const_index *idx, unsigned hash, unsigned step) {
+    return &idx->slots[(hash + step) & (idx->capacity - 1)];
+}
+
+/* Record poolIndex in the empty slot found by probing */
+static void index_insert(const_index *idx, unsigned *slot, unsigned poolIndex) {
+    *slot = poolIndex + 1;
+
+    if(++idx->count * 2 > idx->capacity) index_grow(idx);
+}
+
+unsigned consts_newString(char *s) {
+    unsigned hash = hash_string(s);
+    unsigned *slot;
+
+    for(unsigned step = 0; *(slot = index_probe(&stringIndex, hash, step)); step++)
+        if(strcmp(stringConsts[*slot - 1], s) == 0) return *slot - 1;
 
     if(currStringConst == totalStringConsts) expandString();
     assert(currStringConst < totalStringConsts);
@@ -189,14 +302,15 @@ unsigned consts_newString(char *s) {
     stringConsts[currStringConst] = newString;
     unsigned index = currStringConst;
     currStringConst++;
+    index_insert(&stringIndex, slot, index);
     return index;
 }
 unsigned consts_newNum(double n) {
-    for(unsigned i = 0; i < currNumConst; i++) {
-        if(numConsts[i] == n) {
-            return i;
-        }
-    }
+    unsigned hash = hash_number(n);
+    unsigned *slot;
+
+    for(unsigned step = 0; *(slot = index_probe(&numberIndex, hash, step)); step++)
+        if(memcmp(&numConsts[*slot - 1], &n, sizeof(double)) == 0) return *slot - 1;
 
     if(currNumConst == totalNumConsts) expandNum();
     assert(currNumConst < totalNumConsts);
@@ -204,13 +318,17 @@ unsigned consts_newNum(double n) {
     numConsts[currNumConst] = n;
     unsigned index = currNumConst;
     currNumConst++;
+    index_insert(&numberIndex, slot, index);
     return index;
 }
 unsigned libfuncs_newused(char *s) {
     if(!s) return 0;
 
-    for(unsigned i = 0; i < currLibfunct; i++)
-        if(libFuncs[i] && strcmp(libFuncs[i], s) == 0) return i;
+    unsigned hash = hash_string(s);
+    unsigned *slot;
+
+    for(unsigned step = 0; *(slot = index_probe(&libfuncIndex, hash, step)); step++)
+        if(strcmp(libFuncs[*slot - 1], s) == 0) return *slot - 1;
 
     if(currLibfunct == totalNameLibfuncs) expandLibfunc();
     assert(currLibfunct < totalNameLibfuncs);
@@ -221,16 +339,18 @@ unsigned libfuncs_newused(char *s) {
 
     unsigned index = currLibfunct;
     currLibfunct++;
+    index_insert(&libfuncIndex, slot, index);
     return index;
 }
 unsigned userfuncs_newused(SymTableEntry *s) {
     if(!s) return 0;
 
-    for(unsigned i = 0; i < currUserfunct; i++) {
-        if(userFuncs[i].address == s->taddress &&
-                userFuncs[i].id && strcmp(userFuncs[i].id, s->name) == 0) {
-            return i;
-        }
+    unsigned hash = hash_userfunc(s->taddress, s->name);
+    unsigned *slot;
+
+    for(unsigned step = 0; *(slot = index_probe(&userfuncIndex, hash, step)); step++) {
+        userfunc_t *f = &userFuncs[*slot - 1];
+        if(f->address == s->taddress && strcmp(f->id, s->name) == 0) return *slot - 1;
     }
 
     if(currUserfunct == totalUserFuncs) expandUserfunc();
@@ -244,6 +364,7 @@ unsigned userfuncs_newused(SymTableEntry *s) {
 
     unsigned index = currUserfunct;
     currUserfunct++;
+    index_insert(&userfuncIndex, slot, index);
     return index;
 }
 
@@ -253,17 +374,9 @@ void emit_tcode(instruction *instr) {
     instructions[currInstructions].opcode = instr->opcode;
     instructions[currInstructions].srcLine = instr->srcLine;
 
-    instructions[currInstructions].arg1 = malloc(sizeof(vmarg));
-    instructions[currInstructions].arg2 = malloc(sizeof(vmarg));
-    instructions[currInstructions].result = malloc(sizeof(vmarg));
-
-    assert(instructions[currInstructions].arg1 != NULL);
-    assert(instructions[currInstructions].arg2 != NULL);
-    assert(instructions[currInstructions].result != NULL);
-
-    *(instructions[currInstructions].arg1) = *(instr->arg1);
-    *(instructions[currInstructions].arg2) = *(instr->arg2);
-    *(instructions[currInstructions].result) = *(instr->result);
+    instructions[currInstructions].arg1 = instr->arg1;
+    instructions[currInstructions].arg2 = instr->arg2;
+    instructions[currInstructions].result = instr->result;
 
     ++currInstructions;
 }
@@ -393,25 +506,22 @@ void generate(void) {
 }
 
 void generate_op(vmopcode op, Quad *quad) {
-    instruction *instr = mallocInstr();
+    instruction *instr = newInstr(quad);
 
     instr->opcode = op;
     quad->taddress = nextinstructionlabel();
-    instr->srcLine = quad->line;
 
     if(quad->arg1) make_operand(quad->arg1, instr->arg1);
     if(quad->arg2) make_operand(quad->arg2, instr->arg2);
     if(quad->result) make_operand(quad->result, instr->result);
 
     emit_tcode(instr);
-    freeInstr(instr);
 }
 
 void generate_relational(vmopcode op, Quad *quad) {
-    instruction *instr = mallocInstr();
+    instruction *instr = newInstr(quad);
     instr->opcode = op;
     quad->taddress = nextinstructionlabel();
-    instr->srcLine = quad->line;
 
     if(quad->arg1) make_operand(quad->arg1, instr->arg1);
     if(quad->arg2) make_operand(quad->arg2, instr->arg2);
@@ -419,35 +529,32 @@ void generate_relational(vmopcode op, Quad *quad) {
     instr->result->val = quad->label;
 
     emit_tcode(instr);
-    freeInstr(instr);
 }
 
 void generate_ADD(Quad *quad) {
-    generate_op(add_v, quad);
+    generate_op(quad->numeric ? add_nn_v : add_v, quad);
 }
 void generate_SUB(Quad *quad) {
-    generate_op(sub_v, quad);
+    generate_op(quad->numeric ? sub_nn_v : sub_v, quad);
 }
 void generate_MUL(Quad *quad) {
-    generate_op(mul_v, quad);
+    generate_op(quad->numeric ? mul_nn_v : mul_v, quad);
 }
 void generate_DIV(Quad *quad) {
-    generate_op(div_v, quad);
+    generate_op(quad->numeric ? div_nn_v : div_v, quad);
 }
 void generate_MOD(Quad *quad) {
-    generate_op(mod_v, quad);
+    generate_op(quad->numeric ? mod_nn_v : mod_v, quad);
 }
 
 void generate_UMINUS(Quad *quad) {
-    instruction *instr = mallocInstr();
-    instr->opcode = mul_v;
+    instruction *instr = newInstr(quad);
+    instr->opcode = quad->numeric ? mul_nn_v : mul_v;
     quad->taddress = nextinstructionlabel();
-    instr->srcLine = quad->line;
     make_operand(quad->arg1, instr->arg1);
     make_numOperand(instr->arg2, -1.0);
     make_operand(quad->result, instr->result);
     emit_tcode(instr);
-    freeInstr(instr);
 }
 
 void generate_NEWTABLE(Quad *quad)     {
@@ -460,33 +567,31 @@ void generate_TABLESETELEM(Quad *quad) {
     generate_op(tablesetelem_v, quad);
 }
 void generate_ASSIGN(Quad *quad)       {
-    generate_op(assign_v, quad);
+    generate_op(quad->numeric ? assign_num_v : assign_v, quad);
 }
 void generate_NOP(Quad *quad)          {
-    instruction t;
-    t.opcode = nop_v;
-    emit_tcode(&t);
+    emit_tcode(newInstr(quad));
 }
 void generate_JUMP(Quad *quad)         {
     generate_relational(jump_v, quad);
 }
 void generate_IF_EQ(Quad *quad)        {
-    generate_relational(jeq_v, quad);
+    generate_relational(quad->numeric ? jeq_nn_v : jeq_v, quad);
 }
 void generate_IF_NOTEQ(Quad *quad)     {
-    generate_relational(jne_v, quad);
+    generate_relational(quad->numeric ? jne_nn_v : jne_v, quad);
 }
 void generate_IF_GREATER(Quad *quad)   {
-    generate_relational(jgt_v, quad);
+    generate_relational(quad->numeric ? jgt_nn_v : jgt_v, quad);
 }
 void generate_IF_GREATEREQ(Quad *quad) {
-    generate_relational(jge_v, quad);
+    generate_relational(quad->numeric ? jge_nn_v : jge_v, quad);
 }
 void generate_IF_LESS(Quad *quad)      {
-    generate_relational(jlt_v, quad);
+    generate_relational(quad->numeric ? jlt_nn_v : jlt_v, quad);
 }
 void generate_IF_LESSEQ(Quad *quad)    {
-    generate_relational(jle_v, quad);
+    generate_relational(quad->numeric ? jle_nn_v : jle_v, quad);
 }
 
 void generate_NOT(Quad *quad) {
@@ -503,28 +608,50 @@ void generate_AND(Quad *quad) {
 
 void generate_PARAM(Quad *quad) {
     quad->taddress = nextinstructionlabel();
-    instruction *instr = mallocInstr();
+    instruction *instr = newInstr(quad);
     instr->opcode = pusharg_v;
     make_operand(quad->arg1, instr->arg1);
     emit_tcode(instr);
-    freeInstr(instr);
 }
+/* return f(x); in a function leaves a call whose result is returned before anything else runs */
+static int is_tailcall(Quad *quad) {
+    Quad *get = quad + 1, *ret_quad = quad + 2;
+
+    if(isEmptyStack(funcStack) || ret_quad >= quads + curr_quad) return 0;
+    if(get->op != getretval || ret_quad->op != ret || !ret_quad->arg1) return 0;
+    return get->result->sym && ret_quad->arg1->sym == get->result->sym;
+}
+
+/*
+ * A named function cannot be assigned, so a call naming one always lands
+ * there; copy propagation turns calls through a local holding one into
+ * such calls too. calldirect carries the callee's funcenter address in
+ * result and its local count in arg2, both known once its funcstart has
+ * been generated, which comes before any call to it.
+ */
 void generate_CALL(Quad *quad) {
     quad->taddress = nextinstructionlabel();
-    instruction *instr = mallocInstr();
-    instr->opcode = call_v;
+    instruction *instr = newInstr(quad);
+    instr->opcode = is_tailcall(quad) ? tailcall_v : call_v;
     make_operand(quad->arg1, instr->arg1);
+
+    if(instr->opcode == call_v && quad->arg1->type == programfunc_e) {
+        instr->opcode = calldirect_v;
+        instr->result->type = label_a;
+        instr->result->val = quad->arg1->sym->taddress;
+        instr->arg2->type = label_a;
+        instr->arg2->val = quad->arg1->sym->localCount;
+    }
+
     emit_tcode(instr);
-    freeInstr(instr);
 }
 void generate_GETRETVAL(Quad *quad) {
     quad->taddress = nextinstructionlabel();
-    instruction *instr = mallocInstr();
+    instruction *instr = newInstr(quad);
     instr->opcode = assign_v;
     make_operand(quad->result, instr->result);
     make_retvalOperand(instr->arg1);
     emit_tcode(instr);
-    freeInstr(instr);
 }
 
 void generate_FUNCSTART(Quad *quad) {
@@ -535,18 +662,16 @@ void generate_FUNCSTART(Quad *quad) {
     userfuncs_newused(func);
     pushStack(funcStack, func);
 
-    instruction *instr = mallocInstr();
+    instruction *instr = newInstr(quad);
     instr->opcode = funcenter_v;
     make_operand(quad->result, instr->result);
     emit_tcode(instr);
-    freeInstr(instr);
 }
 
 void generate_RETURN(Quad *quad) {
     quad->taddress = nextinstructionlabel();
-    instruction *assignInstr = mallocInstr();
+    instruction *assignInstr = newInstr(quad);
     assignInstr->opcode = assign_v;
-    assignInstr->srcLine = quad->line;
     make_retvalOperand(assignInstr->result);
 
     if(quad->arg1) make_operand(quad->arg1, assignInstr->arg1);
@@ -556,18 +681,16 @@ void generate_RETURN(Quad *quad) {
     }
 
     emit_tcode(assignInstr);
-    freeInstr(assignInstr);
 }
 
 void generate_FUNCEND(Quad *quad) {
     popStack(funcStack);
 
     quad->taddress = nextinstructionlabel();
-    instruction *instr = mallocInstr();
+    instruction *instr = newInstr(quad);
     instr->opcode = funcexit_v;
     make_operand(quad->result, instr->result);
     emit_tcode(instr);
-    freeInstr(instr);
 }
 
 void print_instructions() {
@@ -578,7 +701,9 @@ void print_instructions() {
     const char *opcodes[] = {
         "assign", "add", "sub", "mul", "div", "mod", "uminus", "and", "or", "not",
         "jeq", "jne", "jle", "jge", "jlt", "jgt", "jump", "call", "pusharg",
-        "funcenter", "funcexit", "newtable", "tablegetelem", "tablesetelem", "nop"
+        "funcenter", "funcexit", "newtable", "tablegetelem", "tablesetelem",
+        "tailcall", "calldirect", "add_nn", "sub_nn", "mul_nn", "div_nn", "mod_nn", "jeq_nn", "jne_nn",
+        "jle_nn", "jge_nn", "jlt_nn", "jgt_nn", "assign_num", "nop"
     };
 
     const char *arg_types[] = {
@@ -647,10 +772,13 @@ void print_constants() {
 }
 
 void write_binary_file(FILE *file) {
+    long mark = ftell(file);
     unsigned magic = AVM_MAGICNUMBER;
     fwrite(&magic, sizeof(unsigned), 1, file);
 
     fwrite(&programVarCount, sizeof(unsigned), 1, file);
+    abcSectionBytes[ABC_HEADER] = ftell(file) - mark;
+    mark = ftell(file);
 
     // Write string constants
     fwrite(&currStringConst, sizeof(unsigned), 1, file);
@@ -659,12 +787,16 @@ void write_binary_file(FILE *file) {
         fwrite(&len, sizeof(unsigned), 1, file);
         fwrite(stringConsts[i], sizeof(char), len, file);
     }
+    abcSectionBytes[ABC_STRINGS] = ftell(file) - mark;
+    mark = ftell(file);
 
     // Write numeric constants
     fwrite(&currNumConst, sizeof(unsigned), 1, file);
     if(currNumConst > 0) {
         fwrite(numConsts, sizeof(double), currNumConst, file);
     }
+    abcSectionBytes[ABC_NUMBERS] = ftell(file) - mark;
+    mark = ftell(file);
 
     // Write library functions
     fwrite(&currLibfunct, sizeof(unsigned), 1, file);
@@ -673,6 +805,8 @@ void write_binary_file(FILE *file) {
         fwrite(&len, sizeof(unsigned), 1, file);
         fwrite(libFuncs[i], sizeof(char), len, file);
     }
+    abcSectionBytes[ABC_LIBFUNCS] = ftell(file) - mark;
+    mark = ftell(file);
 
     // Write user functions
     fwrite(&currUserfunct, sizeof(unsigned), 1, file);
@@ -685,6 +819,8 @@ void write_binary_file(FILE *file) {
         fwrite(&len, sizeof(unsigned), 1, file);
         fwrite(userFuncs[i].id, sizeof(char), len, file);
     }
+    abcSectionBytes[ABC_USERFUNCS] = ftell(file) - mark;
+    mark = ftell(file);
 
     // Write instructions
     unsigned instrCount = currInstructions - 1;
@@ -698,4 +834,5 @@ void write_binary_file(FILE *file) {
         fwrite(instr->arg1, sizeof(vmarg), 1, file);
         fwrite(instr->arg2, sizeof(vmarg), 1, file);
     }
+    abcSectionBytes[ABC_CODE] = ftell(file) - mark;
 }
\ No newline at end of file
@@ -0,0 +1,440 @@
+#include "../headers/temp_alloc.h"
+#include "../headers/quad.h"
+#include "../headers/scope_offset_manager.h"
+#include <limits.h>
+
+extern unsigned int programVarCount;
+
+unsigned long tempsAllocated = 0;
+unsigned long tempSlots = 0;
+
+/* The top-level code or one function body, without the functions nested in it */
+typedef struct code_unit {
+    SymTableEntry *func;        /* NULL for the top-level code */
+    unsigned *quads;            /* indices into quads, in order */
+    unsigned count, size;
+    unsigned *temps;            /* tempIds of the temporaries in this unit's frame */
+    unsigned tempCount, tempSize;
+    SymTableEntry **named;      /* named variables of the frame, by offset */
+    unsigned namedSize;
+} code_unit;
+
+typedef struct temp_info {
+    SymTableEntry *sym;
+    unsigned frame;             /* unit whose frame holds it */
+    int pinned;                 /* used outside its frame's code: keeps a slot to itself */
+    unsigned start, end;        /* first and last position where it is live */
+    unsigned lastDef;           /* 1 + block of the latest def seen */
+    unsigned liveIn;            /* 1 + block where a live-in was last recorded */
+    unsigned defs;              /* 1 + head of its def_node list */
+    unsigned slot;
+} temp_info;
+
+typedef struct def_node {
+    unsigned block;
+    unsigned next;              /* 1 + index, 0 ends the list */
+} def_node;
+
+typedef struct live_in {
+    unsigned temp;
+    unsigned block;
+} live_in;
+
+static code_unit *units;
+static unsigned unitCount, unitSize;
+static unsigned *unitOf;        /* by quad */
+static unsigned *posOf;         /* by quad, position within its unit */
+
+static temp_info *temps;        /* by tempId */
+
+static def_node *defNodes;
+static unsigned defCount, defSize;
+static live_in *liveIns;
+static unsigned liveInCount, liveInSize;
+
+static void *temp_alloc_calloc(size_t count, size_t size) {
+    void *p = calloc(count ? count : 1, size);
+    if(!p) {
+        fprintf(stderr, "Error: Memory allocation failed for temporary allocation\n");
+        exit(1);
+    }
+    return p;
+}
+
+/* Makes room for one more element at index used */
+static void *temp_alloc_reserve(void *array, unsigned used, unsigned *size, size_t elem) {
+    if(used < *size) return array;
+
+    *size = *size ? *size * 2 : TEMP_ALLOC_INITIAL_UNITS;
+    array = realloc(array, *size * elem);
+    if(!array) {
+        fprintf(stderr, "Error: Memory allocation failed for temporary allocation\n");
+        exit(1);
+    }
+    return array;
+}
+
+static void split_units(void) {
+    unsigned *open = temp_alloc_calloc(curr_quad, sizeof(unsigned));
+    unsigned depth = 0;
+
+    units = temp_alloc_reserve(NULL, 0, &unitSize, sizeof(code_unit));
+    memset(&units[0], 0, sizeof(code_unit));
+    unitCount = 1;
+
+    for(unsigned i = 1; i < curr_quad; ++i) {
+        if(quads[i].op == funcstart) {
+            units = temp_alloc_reserve(units, unitCount, &unitSize, sizeof(code_unit));
+            memset(&units[unitCount], 0, sizeof(code_unit));
+            units[unitCount].func = quads[i].result ? quads[i].result->sym : NULL;
+            open[++depth] = unitCount++;
+        }
+
+        code_unit *unit = &units[open[depth]];
+        unit->quads = temp_alloc_reserve(unit->quads, unit->count, &unit->size, sizeof(unsigned));
+        unitOf[i] = open[depth];
+        posOf[i] = unit->count;
+        unit->quads[unit->count++] = i;
+
+        if(quads[i].op == funcend && depth) --depth;
+    }
+
+    free(open);
+}
+
+/* Returns 0 if the symbol does not fit the frame layout this pass assumes */
+static int note_symbol(unsigned u, SymTableEntry *sym) {
+    if(sym->space != PROGRAM_SPACE && sym->space != LOCAL_SPACE) return 1;
+    if(sym->space == LOCAL_SPACE && u == 0) return 0;
+
+    if(sym->tempId) {
+        temp_info *t = &temps[sym->tempId];
+
+        if(!t->sym) {
+            code_unit *frame;
+
+            t->sym = sym;
+            t->frame = sym->space == PROGRAM_SPACE ? 0 : u;
+            t->start = UINT_MAX;
+
+            frame = &units[t->frame];
+            frame->temps = temp_alloc_reserve(frame->temps, frame->tempCount, &frame->tempSize, sizeof(unsigned));
+            frame->temps[frame->tempCount++] = sym->tempId;
+        }
+        else if(t->sym != sym) return 0;
+
+        if(t->frame != u) t->pinned = 1;
+        return 1;
+    }
+
+    code_unit *frame = &units[sym->space == PROGRAM_SPACE ? 0 : u];
+
+    if(sym->offset >= frame->namedSize) {
+        unsigned oldSize = frame->namedSize;
+
+        frame->namedSize = sym->offset + 1 > 2 * oldSize ? sym->offset + 1 : 2 * oldSize;
+        frame->named = realloc(frame->named, frame->namedSize * sizeof(SymTableEntry *));
+        if(!frame->named) {
+            fprintf(stderr, "Error: Memory allocation failed for temporary allocation\n");
+            exit(1);
+        }
+        memset(frame->named + oldSize, 0, (frame->namedSize - oldSize) * sizeof(SymTableEntry *));
+    }
+
+    if(frame->named[sym->offset] && frame->named[sym->offset] != sym) return 0;
+    frame->named[sym->offset] = sym;
+    return 1;
+}
+
+static void touch(temp_info *t, unsigned pos) {
+    if(pos < t->start) t->start = pos;
+    if(pos > t->end) t->end = pos;
+}
+
+static int defines(temp_info *t, unsigned block) {
+    for(unsigned n = t->defs; n; n = defNodes[n - 1].next)
+        if(defNodes[n - 1].block == block) return 1;
+    return 0;
+}
+
+/* The temporary an operand refers to, if it belongs to this unit's frame and may share */
+static temp_info *unit_temp(unsigned u, Expr *e) {
+    SymTableEntry *sym = operandVariable(e);
+
+    if(!sym || !sym->tempId) return NULL;
+    if(temps[sym->tempId].frame != u || temps[sym->tempId].pinned) return NULL;
+    return &temps[sym->tempId];
+}
+
+/*
+ * Live ranges as the hull of every position a temporary is live at. Uses
+ * and defs are found in one forward sweep; a use with no def before it in
+ * its block is then followed back through the predecessors until a def.
+ */
+static void compute_ranges(unsigned u, unsigned blockBase) {
+    code_unit *unit = &units[u];
+    unsigned n = unit->count;
+    char *leader = temp_alloc_calloc(n + 1, 1);
+    unsigned *blockOf = temp_alloc_calloc(n, sizeof(unsigned));
+
+    leader[0] = 1;
+    for(unsigned p = 0; p < n; ++p) {
+        Quad *q = &quads[unit->quads[p]];
+
+        if(!isBranch(q->op)) continue;
+        leader[p + 1] = 1;
+        if(q->label > 0 && q->label < curr_quad && unitOf[q->label] == u) leader[posOf[q->label]] = 1;
+    }
+
+    unsigned blocks = 0;
+    for(unsigned p = 0; p < n; ++p) blocks += leader[p];
+
+    unsigned *first = temp_alloc_calloc(blocks + 1, sizeof(unsigned));
+    blocks = 0;
+    for(unsigned p = 0; p < n; ++p) {
+        if(leader[p]) first[blocks++] = p;
+        blockOf[p] = blocks - 1;
+    }
+    first[blocks] = n;
+
+    /* Predecessors, stored by target block */
+    unsigned *succ = temp_alloc_calloc(2 * blocks, sizeof(unsigned));
+    unsigned *succs = temp_alloc_calloc(blocks, sizeof(unsigned));
+    unsigned *predStart = temp_alloc_calloc(blocks + 1, sizeof(unsigned));
+
+    for(unsigned b = 0; b < blocks; ++b) {
+        Quad *last = &quads[unit->quads[first[b + 1] - 1]];
+
+        if(isBranch(last->op) && last->label > 0 && last->label < curr_quad && unitOf[last->label] == u)
+            succ[2 * b + succs[b]++] = blockOf[posOf[last->label]];
+        if(last->op != jump && last->op != funcend && b + 1 < blocks)
+            succ[2 * b + succs[b]++] = b + 1;
+
+        for(unsigned s = 0; s < succs[b]; ++s) predStart[succ[2 * b + s] + 1]++;
+    }
+    for(unsigned b = 0; b < blocks; ++b) predStart[b + 1] += predStart[b];
+
+    unsigned *preds = temp_alloc_calloc(predStart[blocks], sizeof(unsigned));
+    unsigned *fill = temp_alloc_calloc(blocks, sizeof(unsigned));
+    for(unsigned b = 0; b < blocks; ++b)
+        for(unsigned s = 0; s < succs[b]; ++s) {
+            unsigned target = succ[2 * b + s];
+            preds[predStart[target] + fill[target]++] = b;
+        }
+
+    liveInCount = 0;
+    for(unsigned p = 0; p < n; ++p) {
+        Quad *q = &quads[unit->quads[p]];
+        unsigned mark = blockBase + blockOf[p] + 1;
+        Expr *uses[3] = { q->arg1, q->arg2, writesResult(q->op) ? NULL : q->result };
+        temp_info *t;
+
+        for(int i = 0; i < 3; ++i) {
+            if(!(t = unit_temp(u, uses[i]))) continue;
+
+            touch(t, p);
+            if(t->lastDef == mark || t->liveIn == mark) continue;
+
+            t->liveIn = mark;
+            liveIns = temp_alloc_reserve(liveIns, liveInCount, &liveInSize, sizeof(live_in));
+            liveIns[liveInCount].temp = t->sym->tempId;
+            liveIns[liveInCount++].block = blockOf[p];
+        }
+
+        if(!writesResult(q->op) || !(t = unit_temp(u, q->result))) continue;
+
+        touch(t, p);
+        if(t->lastDef != mark) {
+            defNodes = temp_alloc_reserve(defNodes, defCount, &defSize, sizeof(def_node));
+            defNodes[defCount].block = blockOf[p];
+            defNodes[defCount].next = t->defs;
+            t->defs = ++defCount;
+        }
+        t->lastDef = mark;
+    }
+
+    unsigned *visited = temp_alloc_calloc(blocks, sizeof(unsigned));
+    unsigned *stack = temp_alloc_calloc(blocks, sizeof(unsigned));
+
+    for(unsigned i = 0; i < liveInCount; ++i) {
+        unsigned id = liveIns[i].temp, top = 0;
+        temp_info *t = &temps[id];
+
+        if(visited[liveIns[i].block] == id) continue;
+        visited[liveIns[i].block] = id;
+        stack[top++] = liveIns[i].block;
+
+        while(top) {
+            unsigned b = stack[--top];
+
+            touch(t, first[b]);
+            for(unsigned k = predStart[b]; k < predStart[b + 1]; ++k) {
+                unsigned pred = preds[k];
+
+                touch(t, first[pred + 1] - 1);
+                if(defines(t, pred) || visited[pred] == id) continue;
+                visited[pred] = id;
+                stack[top++] = pred;
+            }
+        }
+    }
+
+    free(stack);
+    free(visited);
+    free(fill);
+    free(preds);
+    free(predStart);
+    free(succs);
+    free(succ);
+    free(first);
+    free(blockOf);
+    free(leader);
+}
+
+static int by_start(const void *a, const void *b) {
+    temp_info *x = &temps[*(const unsigned *)a], *y = &temps[*(const unsigned *)b];
+
+    if(x->start != y->start) return x->start < y->start ? -1 : 1;
+    return *(const unsigned *)a < *(const unsigned *)b ? -1 : 1;
+}
+
+/* Min-heap of the tempIds holding a slot, by the end of their range */
+static void heap_push(unsigned *heap, unsigned *size, unsigned id) {
+    unsigned i = (*size)++;
+
+    while(i && temps[heap[(i - 1) / 2]].end > temps[id].end) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = id;
+}
+
+static unsigned heap_pop(unsigned *heap, unsigned *size) {
+    unsigned top = heap[0], last = heap[--(*size)], i = 0;
+
+    for(;;) {
+        unsigned child = 2 * i + 1;
+
+        if(child >= *size) break;
+        if(child + 1 < *size && temps[heap[child + 1]].end < temps[heap[child]].end) ++child;
+        if(temps[heap[child]].end >= temps[last].end) break;
+
+        heap[i] = heap[child];
+        i = child;
+    }
+    if(*size) heap[i] = last;
+    return top;
+}
+
+/* Linear scan; returns the number of slots used */
+static unsigned assign_slots(code_unit *unit) {
+    unsigned *active = temp_alloc_calloc(unit->tempCount, sizeof(unsigned));
+    unsigned *freeSlots = temp_alloc_calloc(unit->tempCount, sizeof(unsigned));
+    unsigned activeCount = 0, freeCount = 0, slots = 0;
+
+    for(unsigned i = 0; i < unit->tempCount; ++i) {
+        temp_info *t = &temps[unit->temps[i]];
+
+        if(t->pinned) {
+            t->start = 0;
+            t->end = UINT_MAX;
+        }
+    }
+
+    qsort(unit->temps, unit->tempCount, sizeof(unsigned), by_start);
+
+    for(unsigned i = 0; i < unit->tempCount; ++i) {
+        temp_info *t = &temps[unit->temps[i]];
+
+        /* a slot is free once its last use is strictly before this def */
+        while(activeCount && temps[active[0]].end < t->start)
+            freeSlots[freeCount++] = temps[heap_pop(active, &activeCount)].slot;
+
+        t->slot = freeCount ? freeSlots[--freeCount] : slots++;
+        heap_push(active, &activeCount, unit->temps[i]);
+    }
+
+    free(freeSlots);
+    free(active);
+    return slots;
+}
+
+static void renumber_frame(code_unit *unit, unsigned slots) {
+    unsigned named = 0;
+
+    for(unsigned i = 0; i < unit->namedSize; ++i)
+        if(unit->named[i]) unit->named[i]->offset = named++;
+
+    for(unsigned i = 0; i < unit->tempCount; ++i)
+        temps[unit->temps[i]].sym->offset = named + temps[unit->temps[i]].slot;
+
+    if(unit->func) unit->func->localCount = named + slots;
+    else programVarCount = named + slots;
+
+    tempsAllocated += unit->tempCount;
+    tempSlots += slots;
+}
+
+static void free_units(void) {
+    for(unsigned u = 0; u < unitCount; ++u) {
+        free(units[u].quads);
+        free(units[u].temps);
+        free(units[u].named);
+    }
+    free(units);
+    free(temps);
+    free(posOf);
+    free(unitOf);
+    free(defNodes);
+    free(liveIns);
+
+    units = NULL;
+    unitCount = unitSize = 0;
+    defNodes = NULL;
+    defCount = defSize = 0;
+    liveIns = NULL;
+    liveInCount = liveInSize = 0;
+}
+
+void allocate_temps(void) {
+    int consistent = 1;
+    unsigned blockBase = 0;
+
+    if(curr_quad <= 1) return;
+
+    unitOf = temp_alloc_calloc(curr_quad + 1, sizeof(unsigned));
+    posOf = temp_alloc_calloc(curr_quad + 1, sizeof(unsigned));
+    temps = temp_alloc_calloc(temp_counter + 1, sizeof(temp_info));
+
+    split_units();
+
+    for(unsigned u = 0; u < unitCount && consistent; ++u) {
+        for(unsigned p = 0; p < units[u].count && consistent; ++p) {
+            Quad *q = &quads[units[u].quads[p]];
+            Expr *operands[3] = { q->arg1, q->arg2, q->result };
+
+            for(int i = 0; i < 3 && consistent; ++i) {
+                SymTableEntry *sym = operandVariable(operands[i]);
+                if(sym) consistent = note_symbol(u, sym);
+            }
+        }
+    }
+
+    /* Leave the frames as the parser laid them out rather than guess */
+    if(!consistent) {
+        free_units();
+        return;
+    }
+
+    for(unsigned u = 0; u < unitCount; ++u) {
+        compute_ranges(u, blockBase);
+        blockBase += units[u].count;
+    }
+
+    for(unsigned u = 0; u < unitCount; ++u) {
+        if(u && !units[u].func) continue;
+        renumber_frame(&units[u], assign_slots(&units[u]));
+    }
+
+    free_units();
+}
@@ -0,0 +1,177 @@
+#include "../headers/type_infer.h"
+
+typedef struct type_state {
+    cfg_function *f;
+    unsigned char *number;          /* by value: a number wherever it is read */
+    unsigned char *checked;         /* by value: an operation that stops on anything else dominates */
+    unsigned *log;                  /* checked values; leaving a dominator subtree pops what it added */
+    unsigned logCount;
+    unsigned long marked;
+} type_state;
+
+static int is_arith(iopcode op) {
+    return op == add || op == sub || op == mul || op == div_op || op == mod_op || op == uminus;
+}
+
+static int is_ordering(iopcode op) {
+    return op == if_lesseq || op == if_greatereq || op == if_less || op == if_greater;
+}
+
+static int source_is_number(type_state *s, cfg_instr *instr, int operand) {
+    Expr *e = *cfg_operand(instr, operand);
+    unsigned v = instr->value[operand];
+
+    if(!e) return 0;
+    if(v) return s->number[v];
+    return e->type == constnum_e;
+}
+
+/* Every copy and phi starts out a number, until one of its sources is not */
+static void find_numbers(type_state *s) {
+    cfg_function *f = s->f;
+
+    for(unsigned v = 1; v < f->valueCount; ++v) {
+        ssa_value *value = &f->values[v];
+
+        if(value->pos == -1) s->number[v] = 1;
+        else if(value->pos >= 0) {
+            iopcode op = f->blocks[value->block].instrs[value->pos].quad.op;
+            s->number[v] = is_arith(op) || op == assign;
+        }
+    }
+
+    for(int changed = 1; changed; ) {
+        changed = 0;
+
+        for(unsigned i = 0; i < f->reachable; ++i) {
+            cfg_block *block = &f->blocks[f->rpoOrder[i]];
+
+            for(unsigned j = 0; j < block->phiCount; ++j) {
+                cfg_phi *phi = &block->phis[j];
+
+                if(phi->dead || !s->number[phi->value]) continue;
+                for(unsigned e = 0; e < block->predCount; ++e) {
+                    if(!phi->args[e] || !s->number[phi->args[e]]) {
+                        s->number[phi->value] = 0;
+                        changed = 1;
+                        break;
+                    }
+                }
+            }
+
+            for(unsigned j = 0; j < block->count; ++j) {
+                cfg_instr *instr = &block->instrs[j];
+                unsigned v = instr->value[CFG_RESULT];
+
+                if(instr->dead || instr->quad.op != assign || !v || !s->number[v]) continue;
+                if(!source_is_number(s, instr, CFG_ARG1)) {
+                    s->number[v] = 0;
+                    changed = 1;
+                }
+            }
+        }
+    }
+}
+
+static int reads_number(type_state *s, cfg_instr *instr, int operand) {
+    unsigned v = instr->value[operand];
+    return source_is_number(s, instr, operand) || (v && s->checked[v]);
+}
+
+static void check(type_state *s, unsigned v) {
+    if(!v || s->number[v] || s->checked[v]) return;
+    s->checked[v] = 1;
+    s->log[s->logCount++] = v;
+}
+
+static void visit_block(type_state *s, unsigned b) {
+    cfg_block *block = &s->f->blocks[b];
+
+    for(unsigned j = 0; j < block->count; ++j) {
+        cfg_instr *instr = &block->instrs[j];
+        Quad *q = &instr->quad;
+
+        if(instr->dead) continue;
+
+        switch(q->op) {
+        case add: case sub: case mul: case div_op: case mod_op:
+        case if_eq: case if_noteq: case if_lesseq: case if_greatereq: case if_less: case if_greater:
+            q->numeric = reads_number(s, instr, CFG_ARG1) && reads_number(s, instr, CFG_ARG2);
+            break;
+        case uminus: case assign:
+            q->numeric = reads_number(s, instr, CFG_ARG1);
+            break;
+        default:
+            continue;
+        }
+
+        if(q->numeric) ++s->marked;
+
+        /* Past here the operands were numbers, or the program stopped */
+        if(is_arith(q->op) || is_ordering(q->op)) {
+            check(s, instr->value[CFG_ARG1]);
+            check(s, instr->value[CFG_ARG2]);
+        }
+    }
+}
+
+unsigned long infer_types(cfg_program *p, unsigned func) {
+    cfg_function *f = &p->funcs[func];
+    type_state s;
+
+    if(!f->inSSA) return 0;
+
+    s.f = f;
+    s.number = cfg_calloc(f->valueCount, 1);
+    s.checked = cfg_calloc(f->valueCount, 1);
+    s.log = cfg_calloc(f->valueCount, sizeof(unsigned));
+    s.logCount = 0;
+    s.marked = 0;
+
+    find_numbers(&s);
+
+    for(unsigned b = 0; b < f->blockCount; ++b) {
+        for(unsigned i = 0; i < f->blocks[b].phiCount; ++i) {
+            cfg_phi *phi = &f->blocks[b].phis[i];
+
+            phi->numeric = !phi->dead && s.number[phi->value];
+            s.marked += phi->numeric;
+        }
+    }
+
+    unsigned *child;
+    unsigned *children = cfg_dom_children(f, &child);
+    unsigned *fill = cfg_calloc(f->blockCount, sizeof(unsigned));
+    unsigned *stack = cfg_calloc(f->blockCount, sizeof(unsigned));
+    unsigned *mark = cfg_calloc(f->blockCount, sizeof(unsigned));
+    unsigned top = 0;
+
+    stack[top++] = 0;
+    visit_block(&s, 0);
+
+    while(top) {
+        unsigned b = stack[top - 1];
+
+        if(fill[b] < child[b + 1] - child[b]) {
+            unsigned c = children[child[b] + fill[b]++];
+
+            mark[c] = s.logCount;
+            visit_block(&s, c);
+            stack[top++] = c;
+            continue;
+        }
+
+        while(s.logCount > mark[b]) s.checked[s.log[--s.logCount]] = 0;
+        --top;
+    }
+
+    free(mark);
+    free(stack);
+    free(fill);
+    free(children);
+    free(child);
+    free(s.log);
+    free(s.checked);
+    free(s.number);
+    return s.marked;
+}
@@ -0,0 +1,32 @@
+#ifndef AVM_COVERAGE_H
+#define AVM_COVERAGE_H
+
+/*
+ * Instruction coverage. While enabled, every executed instruction sets a bit
+ * in its byte of the map: bit 0 when execution fell through to pc + 1, bit 1
+ * when it went elsewhere. For conditional jumps these are the two branch
+ * directions, for everything else any bit means the instruction ran.
+ *
+ * The report is lcov tracefile data (DA, BRDA and FN records) for the source
+ * file next to the binary. If the output file already exists its counts are
+ * added in, so repeated runs accumulate.
+ */
+
+#define AVM_COVERAGE_FALLTHROUGH 1
+#define AVM_COVERAGE_JUMPED      2
+
+/* Coverage map indexed by pc, NULL when coverage is off */
+extern unsigned char *avm_coveragemap;
+
+/* Request coverage into path, before the program is loaded */
+void avm_coverage_enable(char *path);
+
+/* Allocate the map once the code size is known */
+void avm_coverage_begin(void);
+
+/* Merge the map into the report file, returns 0 on success */
+int avm_coverage_write(char *binary);
+
+void avm_coverage_cleanup(void);
+
+#endif
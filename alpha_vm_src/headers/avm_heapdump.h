@@ -0,0 +1,26 @@
+#ifndef AVM_HEAPDUMP_H
+#define AVM_HEAPDUMP_H
+
+#include "avm_tables.h"
+
+#define AVM_HEAPDUMP_VERSION 1
+
+/*
+ * Heap dump file format (text, one record per line):
+ *
+ *   AVMHEAP <version>
+ *   R <kind> <slot> <table id>       root reference (kind: global, stack, stale, retval, register)
+ *   T <id> <refcount> <entries> <bytes> <reachable> <n> <id_1> ... <id_n>
+ *   END
+ *
+ * Every live table gets a T record. <bytes> is the table's own footprint
+ * (table, buckets and owned strings), <reachable> is 1 when the table can be
+ * reached from a live root, and the trailing ids are its outgoing references.
+ * Stale roots are cells below the stack top that still hold a reference;
+ * they keep their tables alive until overwritten, so they count as roots.
+ */
+
+/* Write a heap dump, returns 0 on success */
+int avm_heapdump(char *path);
+
+#endif
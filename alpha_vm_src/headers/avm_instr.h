@@ -10,6 +10,9 @@ typedef void (*execute_func_t)(instruction*);
 /* Dispatch table for instruction execution */
 extern execute_func_t executeFuncs[];
 
+/* Opcode names, indexed by vmopcode */
+extern char *opcodeStrings[];
+
 /* Arithmetic operations */
 void execute_assign(instruction *instr);
 void execute_add(instruction *instr);
@@ -38,12 +41,28 @@ void execute_call(instruction *instr);
 void execute_pusharg(instruction *instr);
 void execute_funcenter(instruction *instr);
 void execute_funcexit(instruction *instr);
+void execute_tailcall(instruction *instr);
+void execute_calldirect(instruction *instr);
 
 /* Table operations */
 void execute_newtable(instruction *instr);
 void execute_tablegetelem(instruction *instr);
 void execute_tablesetelem(instruction *instr);
 
+/* Typed forms, for operands known to be numbers */
+void execute_add_nn(instruction *instr);
+void execute_sub_nn(instruction *instr);
+void execute_mul_nn(instruction *instr);
+void execute_div_nn(instruction *instr);
+void execute_mod_nn(instruction *instr);
+void execute_jeq_nn(instruction *instr);
+void execute_jne_nn(instruction *instr);
+void execute_jle_nn(instruction *instr);
+void execute_jge_nn(instruction *instr);
+void execute_jlt_nn(instruction *instr);
+void execute_jgt_nn(instruction *instr);
+void execute_assign_num(instruction *instr);
+
 /* No operation */
 void execute_nop(instruction *instr);
 
@@ -27,6 +27,9 @@ void libfunc_strtonum(void);
 void libfunc_sqrt(void);
 void libfunc_cos(void);
 void libfunc_sin(void);
+void libfunc_vmstats(void);
+void libfunc_heapdump(void);
+void libfunc_tracedump(void);
 
 /* Utility functions for library function execution */
 unsigned avm_totalactuals(void);
@@ -38,6 +38,10 @@ typedef struct avm_memcell {
 void avm_memcellclear(avm_memcell *m);
 void avm_assign(avm_memcell *lv, avm_memcell *rv);
 
+/* String content allocation (tracked by the memory statistics) */
+char *avm_stringnew(char *s);
+void avm_stringdestroy(char *s);
+
 /* Type checking and conversion */
 unsigned char avm_tobool(avm_memcell *m);
 char *avm_tostring(avm_memcell *m);
@@ -0,0 +1,28 @@
+#ifndef AVM_METRICS_H
+#define AVM_METRICS_H
+
+#include <stdio.h>
+#include <signal.h>
+
+#include "avm.h"
+
+/* Set by the SIGUSR1 handler, consumed at the next safe point */
+extern volatile sig_atomic_t avm_metricsrequested;
+
+/* Executed instructions per opcode */
+extern unsigned long avm_opcodecounts[AVM_MAX_INSTRUCTIONS + 1];
+
+/* Safe points sit on jumps and calls, so a pending request is seen within a
+ * loop iteration or a call; when no signal arrived this is one flag test. */
+#define AVM_SAFEPOINT() \
+    do { if(avm_metricsrequested) avm_metrics_safepoint(); } while(0)
+
+/* Install the SIGUSR1 handler; snapshots go to path (appended) or stderr */
+void avm_metrics_install(char *path);
+
+/* Write one JSON snapshot of the running VM on a single line */
+void avm_metrics_dump(FILE *out);
+
+void avm_metrics_safepoint(void);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef AVM_STATS_H
+#define AVM_STATS_H
+
+#include <stdio.h>
+
+/* Heap counters, kept up to date by the table, bucket and string paths */
+typedef struct avm_memstats {
+    unsigned long liveTables;
+    unsigned long liveBuckets;
+    unsigned long liveStringBytes;
+
+    unsigned long heapBytes;
+    unsigned long peakHeapBytes;
+    unsigned long allocations;
+
+    unsigned long refIncrements;
+    unsigned long refDecrements;
+} avm_memstats;
+
+/* Global counters instance */
+extern avm_memstats memstats;
+
+/* Heap accounting */
+void avm_memstats_alloc(unsigned long bytes);
+void avm_memstats_free(unsigned long bytes);
+
+/* Reporting */
+void avm_memstats_print(FILE *out);
+
+#endif
@@ -21,8 +21,17 @@ typedef struct avm_table {
     avm_table_bucket *strIndexed[AVM_TABLE_HASHSIZE];
     avm_table_bucket *numIndexed[AVM_TABLE_HASHSIZE];
     unsigned total;
+
+    /* Allocation registry (every live table, for heap dumps) */
+    unsigned id;
+    unsigned char dumpMark;
+    struct avm_table *regPrev;
+    struct avm_table *regNext;
 } avm_table;
 
+/* Head of the live table registry */
+extern avm_table *avm_livetables;
+
 /* Table lifecycle management */
 avm_table *avm_tablenew(void);
 void avm_tabledestroy(avm_table *t);
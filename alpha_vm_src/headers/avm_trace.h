@@ -0,0 +1,67 @@
+#ifndef AVM_TRACE_H
+#define AVM_TRACE_H
+
+#include <stdio.h>
+
+#include "avm.h"
+
+#define AVM_TRACE_NOARG 0xff
+
+/* One executed instruction */
+typedef struct avm_trace_instr {
+    unsigned pc;
+    unsigned line;
+    unsigned char opcode;
+    unsigned char types[3];     /* result, arg1, arg2 vmarg_t or AVM_TRACE_NOARG */
+} avm_trace_instr;
+
+/* One call, recorded before the callee runs */
+typedef struct avm_trace_call {
+    unsigned pc;
+    unsigned line;
+    unsigned char type;         /* avm_memcell_t of the called value */
+    unsigned func;              /* userfunc index */
+    char *name;                 /* libfunc name, from the constant pool */
+} avm_trace_call;
+
+/* Ring buffers, sizes are powers of two; tracing is off while they are NULL */
+typedef struct avm_trace {
+    avm_trace_instr *instrs;
+    avm_trace_call *calls;
+    unsigned instrMask;
+    unsigned callMask;
+    unsigned long totalInstrs;
+    unsigned long totalCalls;
+} avm_trace;
+
+extern avm_trace tracering;
+
+/* Allocate the rings and install the SIGABRT handler */
+void avm_trace_initialize(unsigned instrs, unsigned calls);
+void avm_trace_cleanup(void);
+
+/* Print both rings, oldest entry first */
+void avm_trace_dump(FILE *out);
+
+static inline void avm_trace_record(instruction *instr) {
+    avm_trace_instr *e = &tracering.instrs[tracering.totalInstrs++ & tracering.instrMask];
+
+    e->pc = vm.pc;
+    e->line = vm.currLine;
+    e->opcode = (unsigned char)instr->opcode;
+    e->types[0] = instr->result ? (unsigned char)instr->result->type : AVM_TRACE_NOARG;
+    e->types[1] = instr->arg1 ? (unsigned char)instr->arg1->type : AVM_TRACE_NOARG;
+    e->types[2] = instr->arg2 ? (unsigned char)instr->arg2->type : AVM_TRACE_NOARG;
+}
+
+static inline void avm_trace_recordcall(avm_memcell *func) {
+    avm_trace_call *e = &tracering.calls[tracering.totalCalls++ & tracering.callMask];
+
+    e->pc = vm.pc;
+    e->line = vm.currLine;
+    e->type = (unsigned char)func->type;
+    e->func = func->type == userfunc_m ? func->data.funcVal : 0;
+    e->name = func->type == libfunc_m ? func->data.libfuncVal : NULL;
+}
+
+#endif
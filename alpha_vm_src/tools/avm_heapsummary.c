@@ -0,0 +1,533 @@
+/*
+ * Offline summary of a heap dump written by `avm --heap-dump-on-exit=<file>`
+ * or the heapdump() library function (format in avm_heapdump.h).
+ *
+ * Reports the tables with the largest retained size (bytes that would be
+ * freed if the table became unreachable, computed on the dominator tree of
+ * the root graph) and the tables that are alive but unreachable from any
+ * root, grouped into reference cycles.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HEAPSUMMARY_TOP 10
+
+typedef struct heap_table {
+    unsigned id;
+    unsigned refCounter;
+    unsigned entries;
+    unsigned long bytes;
+    unsigned reachable;
+    unsigned nrefs;
+    unsigned *refs;         /* node indices, resolved after loading */
+
+    unsigned long retained;
+    int idom;               /* immediate dominator, -1 when unreachable */
+    unsigned rpo;           /* reverse postorder number */
+
+    int sccIndex, sccLow;
+    int onStack;
+    unsigned scc;
+} heap_table;
+
+typedef struct heap_graph {
+    heap_table *nodes;      /* node 0 is the virtual root */
+    unsigned total;
+    unsigned capacity;
+    unsigned *roots;
+    unsigned totalRoots;
+    unsigned staleRoots;
+} heap_graph;
+
+static void *xmalloc(size_t size) {
+    void *p = malloc(size ? size : 1);
+
+    if(!p) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+
+    return p;
+}
+
+static void *xrealloc(void *p, size_t size) {
+    p = realloc(p, size ? size : 1);
+
+    if(!p) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+
+    return p;
+}
+
+static heap_table *graph_newnode(heap_graph *g) {
+    if(g->total == g->capacity) {
+        g->capacity = g->capacity ? g->capacity * 2 : 64;
+        g->nodes = xrealloc(g->nodes, g->capacity * sizeof(heap_table));
+    }
+
+    heap_table *n = &g->nodes[g->total++];
+    memset(n, 0, sizeof(heap_table));
+    n->idom = -1;
+    return n;
+}
+
+/* Table ids are handed out sequentially, so a dense id -> node map is fine */
+static unsigned *graph_indexbyid(heap_graph *g, unsigned *maxId) {
+    unsigned max = 0;
+
+    for(unsigned i = 1; i < g->total; ++i)
+        if(g->nodes[i].id > max) max = g->nodes[i].id;
+
+    unsigned *index = xmalloc((max + 1) * sizeof(unsigned));
+    memset(index, 0, (max + 1) * sizeof(unsigned));
+
+    for(unsigned i = 1; i < g->total; ++i)
+        index[g->nodes[i].id] = i;
+
+    *maxId = max;
+    return index;
+}
+
+static int graph_load(heap_graph *g, FILE *file) {
+    char kind[32];
+    int version;
+
+    if(fscanf(file, "AVMHEAP %d", &version) != 1) {
+        fprintf(stderr, "Error: Not a heap dump\n");
+        return 1;
+    }
+
+    if(version != 1) {
+        fprintf(stderr, "Error: Unsupported heap dump version %d\n", version);
+        return 1;
+    }
+
+    graph_newnode(g);   /* virtual root */
+
+    unsigned *rootIds = NULL;
+    unsigned rootCapacity = 0;
+
+    for(;;) {
+        if(fscanf(file, "%31s", kind) != 1) {
+            fprintf(stderr, "Error: Truncated heap dump\n");
+            return 1;
+        }
+
+        if(strcmp(kind, "END") == 0) break;
+
+        if(strcmp(kind, "R") == 0) {
+            char rootKind[32];
+            unsigned slot, id;
+
+            if(fscanf(file, "%31s %u %u", rootKind, &slot, &id) != 3) return 1;
+
+            if(strcmp(rootKind, "stale") == 0)
+                ++g->staleRoots;
+
+            if(g->totalRoots == rootCapacity) {
+                rootCapacity = rootCapacity ? rootCapacity * 2 : 16;
+                rootIds = xrealloc(rootIds, rootCapacity * sizeof(unsigned));
+            }
+
+            rootIds[g->totalRoots++] = id;
+        }
+        else if(strcmp(kind, "T") == 0) {
+            heap_table *t = graph_newnode(g);
+
+            if(fscanf(file, "%u %u %u %lu %u %u", &t->id, &t->refCounter, &t->entries,
+                      &t->bytes, &t->reachable, &t->nrefs) != 6) return 1;
+
+            t->refs = xmalloc(t->nrefs * sizeof(unsigned));
+
+            for(unsigned i = 0; i < t->nrefs; ++i)
+                if(fscanf(file, "%u", &t->refs[i]) != 1) return 1;
+        }
+        else {
+            fprintf(stderr, "Error: Unknown record '%s'\n", kind);
+            return 1;
+        }
+    }
+
+    unsigned maxId;
+    unsigned *index = graph_indexbyid(g, &maxId);
+
+    for(unsigned i = 1; i < g->total; ++i) {
+        heap_table *t = &g->nodes[i];
+
+        for(unsigned r = 0; r < t->nrefs; ++r)
+            t->refs[r] = t->refs[r] <= maxId ? index[t->refs[r]] : 0;
+    }
+
+    g->roots = xmalloc(g->totalRoots * sizeof(unsigned));
+
+    for(unsigned i = 0; i < g->totalRoots; ++i)
+        g->roots[i] = rootIds[i] <= maxId ? index[rootIds[i]] : 0;
+
+    g->nodes[0].refs = g->roots;
+    g->nodes[0].nrefs = g->totalRoots;
+
+    free(index);
+    free(rootIds);
+    return 0;
+}
+
+/* Iterative DFS from the virtual root, fills order[] in reverse postorder */
+static unsigned graph_rpo(heap_graph *g, unsigned *order) {
+    unsigned *stack = xmalloc(g->total * sizeof(unsigned));
+    unsigned *next = xmalloc(g->total * sizeof(unsigned));
+    char *seen = xmalloc(g->total);
+    unsigned sp = 0, count = 0;
+
+    memset(seen, 0, g->total);
+    memset(next, 0, g->total * sizeof(unsigned));
+
+    stack[sp++] = 0;
+    seen[0] = 1;
+
+    while(sp) {
+        unsigned v = stack[sp - 1];
+        heap_table *t = &g->nodes[v];
+
+        if(next[v] < t->nrefs) {
+            unsigned w = t->refs[next[v]++];
+
+            if(w && !seen[w]) {
+                seen[w] = 1;
+                stack[sp++] = w;
+            }
+        }
+        else {
+            order[count++] = v;
+            --sp;
+        }
+    }
+
+    for(unsigned i = 0; i < count / 2; ++i) {
+        unsigned tmp = order[i];
+        order[i] = order[count - 1 - i];
+        order[count - 1 - i] = tmp;
+    }
+
+    for(unsigned i = 0; i < count; ++i)
+        g->nodes[order[i]].rpo = i;
+
+    free(stack);
+    free(next);
+    free(seen);
+    return count;
+}
+
+static unsigned graph_intersect(heap_graph *g, unsigned a, unsigned b) {
+    while(a != b) {
+        while(g->nodes[a].rpo > g->nodes[b].rpo) a = g->nodes[a].idom;
+        while(g->nodes[b].rpo > g->nodes[a].rpo) b = g->nodes[b].idom;
+    }
+
+    return a;
+}
+
+/* Cooper, Harvey and Kennedy's iterative dominator algorithm */
+static void graph_dominators(heap_graph *g, unsigned *order, unsigned count) {
+    unsigned *predStart = xmalloc((g->total + 1) * sizeof(unsigned));
+    unsigned *preds;
+    unsigned edges = 0;
+
+    memset(predStart, 0, (g->total + 1) * sizeof(unsigned));
+
+    for(unsigned i = 0; i < count; ++i) {
+        heap_table *t = &g->nodes[order[i]];
+
+        for(unsigned r = 0; r < t->nrefs; ++r)
+            if(t->refs[r]) { ++predStart[t->refs[r] + 1]; ++edges; }
+    }
+
+    for(unsigned i = 1; i <= g->total; ++i)
+        predStart[i] += predStart[i - 1];
+
+    preds = xmalloc(edges * sizeof(unsigned));
+    unsigned *fill = xmalloc(g->total * sizeof(unsigned));
+    memcpy(fill, predStart, g->total * sizeof(unsigned));
+
+    for(unsigned i = 0; i < count; ++i) {
+        heap_table *t = &g->nodes[order[i]];
+
+        for(unsigned r = 0; r < t->nrefs; ++r)
+            if(t->refs[r]) preds[fill[t->refs[r]]++] = order[i];
+    }
+
+    g->nodes[0].idom = 0;
+
+    for(int changed = 1; changed; ) {
+        changed = 0;
+
+        for(unsigned i = 1; i < count; ++i) {
+            unsigned v = order[i];
+            int idom = -1;
+
+            for(unsigned p = predStart[v]; p < predStart[v + 1]; ++p) {
+                unsigned u = preds[p];
+
+                if(g->nodes[u].idom < 0) continue;
+                idom = idom < 0 ? (int)u : (int)graph_intersect(g, u, idom);
+            }
+
+            if(g->nodes[v].idom != idom) {
+                g->nodes[v].idom = idom;
+                changed = 1;
+            }
+        }
+    }
+
+    /* Children come after their dominator in reverse postorder */
+    for(unsigned i = 0; i < count; ++i)
+        g->nodes[order[i]].retained = g->nodes[order[i]].bytes;
+
+    for(unsigned i = count; i-- > 1; )
+        g->nodes[g->nodes[order[i]].idom].retained += g->nodes[order[i]].retained;
+
+    free(predStart);
+    free(preds);
+    free(fill);
+}
+
+/* Tarjan's strongly connected components over the unreachable tables */
+static unsigned graph_scc(heap_graph *g, char *dead) {
+    unsigned *stack = xmalloc(g->total * sizeof(unsigned));
+    unsigned *calls = xmalloc(g->total * sizeof(unsigned));
+    unsigned *next = xmalloc(g->total * sizeof(unsigned));
+    unsigned sp = 0, csp = 0, counter = 0, components = 0;
+
+    for(unsigned i = 0; i < g->total; ++i) {
+        g->nodes[i].sccIndex = -1;
+        next[i] = 0;
+    }
+
+    for(unsigned s = 1; s < g->total; ++s) {
+        if(!dead[s] || g->nodes[s].sccIndex >= 0) continue;
+
+        calls[csp++] = s;
+        g->nodes[s].sccIndex = g->nodes[s].sccLow = counter++;
+        stack[sp++] = s;
+        g->nodes[s].onStack = 1;
+
+        while(csp) {
+            unsigned v = calls[csp - 1];
+            heap_table *t = &g->nodes[v];
+
+            if(next[v] < t->nrefs) {
+                unsigned w = t->refs[next[v]++];
+
+                if(!w || !dead[w]) continue;
+
+                if(g->nodes[w].sccIndex < 0) {
+                    g->nodes[w].sccIndex = g->nodes[w].sccLow = counter++;
+                    stack[sp++] = w;
+                    g->nodes[w].onStack = 1;
+                    calls[csp++] = w;
+                }
+                else if(g->nodes[w].onStack && g->nodes[w].sccIndex < t->sccLow) {
+                    t->sccLow = g->nodes[w].sccIndex;
+                }
+
+                continue;
+            }
+
+            if(t->sccLow == t->sccIndex) {
+                unsigned w;
+
+                do {
+                    w = stack[--sp];
+                    g->nodes[w].onStack = 0;
+                    g->nodes[w].scc = components;
+                } while(w != v);
+
+                ++components;
+            }
+
+            --csp;
+
+            if(csp) {
+                heap_table *parent = &g->nodes[calls[csp - 1]];
+                if(t->sccLow < parent->sccLow) parent->sccLow = t->sccLow;
+            }
+        }
+    }
+
+    free(stack);
+    free(calls);
+    free(next);
+    return components;
+}
+
+typedef struct heap_group {
+    unsigned scc;
+    unsigned tables;
+    unsigned long bytes;
+    unsigned firstId;
+    int cyclic;
+} heap_group;
+
+static int compare_retained(const void *a, const void *b) {
+    const heap_table *x = *(heap_table * const *)a, *y = *(heap_table * const *)b;
+    return (x->retained < y->retained) - (x->retained > y->retained);
+}
+
+static int compare_group(const void *a, const void *b) {
+    const heap_group *x = a, *y = b;
+    return (x->bytes < y->bytes) - (x->bytes > y->bytes);
+}
+
+static void summary_print(heap_graph *g, unsigned top) {
+    unsigned *order = xmalloc(g->total * sizeof(unsigned));
+    unsigned count = graph_rpo(g, order);
+    char *dead = xmalloc(g->total);
+    unsigned long totalBytes = 0, deadBytes = 0;
+    unsigned deadTables = 0;
+
+    graph_dominators(g, order, count);
+
+    for(unsigned i = 1; i < g->total; ++i) {
+        dead[i] = g->nodes[i].idom < 0;
+        totalBytes += g->nodes[i].bytes;
+
+        if(dead[i]) {
+            ++deadTables;
+            deadBytes += g->nodes[i].bytes;
+        }
+    }
+    dead[0] = 0;
+
+    printf("========== AVM HEAP SUMMARY ==========\n");
+    printf("%-22s %u\n", "live tables:", g->total - 1);
+    printf("%-22s %lu\n", "live bytes:", totalBytes);
+    printf("%-22s %u\n", "roots:", g->totalRoots);
+    printf("%-22s %u\n", "stale stack roots:", g->staleRoots);
+    printf("%-22s %u\n", "unreachable tables:", deadTables);
+    printf("%-22s %lu\n", "unreachable bytes:", deadBytes);
+
+    heap_table **byRetained = xmalloc(g->total * sizeof(heap_table *));
+    unsigned reachable = 0;
+
+    for(unsigned i = 1; i < count; ++i)
+        byRetained[reachable++] = &g->nodes[order[i]];
+
+    qsort(byRetained, reachable, sizeof(heap_table *), compare_retained);
+
+    printf("\nLargest retained sizes:\n");
+    printf("  %10s %10s %10s %8s %8s\n", "table", "retained", "self", "entries", "refs");
+
+    for(unsigned i = 0; i < reachable && i < top; ++i)
+        printf("  %10u %10lu %10lu %8u %8u\n", byRetained[i]->id, byRetained[i]->retained,
+               byRetained[i]->bytes, byRetained[i]->entries, byRetained[i]->refCounter);
+
+    if(deadTables) {
+        unsigned components = graph_scc(g, dead);
+        heap_group *groups = xmalloc(components * sizeof(heap_group));
+
+        memset(groups, 0, components * sizeof(heap_group));
+
+        for(unsigned i = 1; i < g->total; ++i) {
+            if(!dead[i]) continue;
+
+            heap_group *grp = &groups[g->nodes[i].scc];
+            grp->scc = g->nodes[i].scc;
+            grp->bytes += g->nodes[i].bytes;
+
+            if(!grp->tables++ || g->nodes[i].id < grp->firstId)
+                grp->firstId = g->nodes[i].id;
+
+            for(unsigned r = 0; r < g->nodes[i].nrefs; ++r)
+                if(g->nodes[i].refs[r] == i) grp->cyclic = 1;
+        }
+
+        unsigned cycles = 0, cyclicTables = 0;
+
+        for(unsigned i = 0; i < components; ++i) {
+            if(groups[i].tables > 1) groups[i].cyclic = 1;
+
+            if(groups[i].cyclic) {
+                cyclicTables += groups[i].tables;
+                groups[cycles++] = groups[i];
+            }
+        }
+
+        qsort(groups, cycles, sizeof(heap_group), compare_group);
+
+        printf("\nUnreachable but alive: %u cycles holding %u tables, "
+               "%u tables kept alive by them\n", cycles, cyclicTables, deadTables - cyclicTables);
+        printf("  %10s %10s %10s\n", "first id", "tables", "bytes");
+
+        for(unsigned i = 0; i < cycles && i < top; ++i)
+            printf("  %10u %10u %10lu\n", groups[i].firstId, groups[i].tables, groups[i].bytes);
+
+        free(groups);
+    }
+
+    printf("======================================\n");
+
+    free(byRetained);
+    free(order);
+    free(dead);
+}
+
+static void print_usage(char *program_name) {
+    printf("Usage: %s [-n <count>] <heap_dump_file>\n", program_name);
+    printf("\nOptions:\n");
+    printf("  -n <count>     Number of tables/cycles listed (default %d)\n", HEAPSUMMARY_TOP);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = NULL;
+    unsigned top = HEAPSUMMARY_TOP;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            top = (unsigned)atoi(argv[++i]);
+        }
+        else if(argv[i][0] != '-' && !filename) {
+            filename = argv[i];
+        }
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(!filename) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(filename, "r");
+
+    if(!file) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+        return 1;
+    }
+
+    heap_graph g;
+    memset(&g, 0, sizeof(g));
+
+    if(graph_load(&g, file) != 0) {
+        fprintf(stderr, "Error: Malformed heap dump '%s'\n", filename);
+        fclose(file);
+        return 1;
+    }
+
+    fclose(file);
+    summary_print(&g, top);
+
+    for(unsigned i = 1; i < g.total; ++i)
+        free(g.nodes[i].refs);
+
+    free(g.roots);
+    free(g.nodes);
+    return 0;
+}
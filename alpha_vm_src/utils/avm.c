@@ -1,4 +1,7 @@
 #include "../headers/avm.h"
+#include "../headers/avm_metrics.h"
+#include "../headers/avm_trace.h"
+#include "../headers/avm_coverage.h"
 
 avm_state vm;
 
@@ -69,9 +72,19 @@ void avm_run(char *filename) {
 
     avm_load_program(file);
     fclose(file);
+    avm_coverage_begin();
 
-    while(!vm.executionFinished)
-        execute_cycle();
+    if(avm_coveragemap) {
+        while(!vm.executionFinished) {
+            unsigned pc = vm.pc;
+            execute_cycle();
+            avm_coveragemap[pc] |= 1 << (vm.pc != pc + 1);
+        }
+    }
+    else {
+        while(!vm.executionFinished)
+            execute_cycle();
+    }
 }
 
 void avm_cleanup(void) {
@@ -170,7 +183,8 @@ void avm_push_envvalue(unsigned val) {
 
 void avm_callsaveenvironment(void) {
     avm_push_envvalue(vm.totalActuals);
-    assert(vm.code[vm.pc].opcode == call_v);
+    assert(vm.code[vm.pc].opcode == call_v || vm.code[vm.pc].opcode == tailcall_v ||
+           vm.code[vm.pc].opcode == calldirect_v);
     avm_push_envvalue(vm.pc + 1);
     avm_push_envvalue(vm.top + vm.totalActuals + 2);
     avm_push_envvalue(vm.topsp);
@@ -348,6 +362,11 @@ void execute_cycle(void) {
         vm.currLine = instr->srcLine;
 
     unsigned oldPC = vm.pc;
+    ++avm_opcodecounts[instr->opcode];
+
+    if(tracering.instrs)
+        avm_trace_record(instr);
+
     (*executeFuncs[instr->opcode])(instr);
 
     if(vm.pc == oldPC)
@@ -405,8 +424,9 @@ avm_memcell *avm_translate_operand(vmarg *arg, avm_memcell *reg) {
             reg->type = nil_m;
             return reg;
         }
+        avm_memcellclear(reg);
         reg->type = string_m;
-        reg->data.strVal = strdup(vm.strings[arg->val]);
+        reg->data.strVal = avm_stringnew(vm.strings[arg->val]);
         return reg;
     }
 
@@ -478,6 +498,7 @@ void avm_call_functor(avm_table *t) {
     vm.cx.type = string_m;
     vm.cx.data.strVal = "()";
     avm_memcell *f = avm_tablegetelem(t, &vm.cx);
+    vm.cx.type = undef_m;
 
     if(!f) {
         avm_error("in calling table: no '()' element found!");
@@ -493,7 +514,7 @@ void avm_call_functor(avm_table *t) {
             avm_dec_top();
             ++vm.totalActuals;
             avm_callsaveenvironment();
-            vm.pc = f->data.funcVal;
+            vm.pc = vm.userfuncs[f->data.funcVal].address;
             assert(vm.pc <= vm.codeSize && vm.code[vm.pc].opcode == funcenter_v);
         } else {
             avm_error("in calling table: illegal '()' element value!");
@@ -0,0 +1,217 @@
+#include "../headers/avm_coverage.h"
+#include "../headers/avm.h"
+
+unsigned char *avm_coveragemap = NULL;
+
+static char *coverage_path = NULL;
+
+/* Counts for one report, indexed by source line and by pc */
+typedef struct coverage_counts {
+    unsigned maxLine;
+    unsigned long *lineHits;    /* [maxLine + 1] */
+    unsigned char *lineCode;    /* line has instructions */
+    unsigned long *taken;       /* [codeSize + 1], conditional jumps only */
+    unsigned long *notTaken;
+    unsigned char *branchSeen;  /* jump executed at least once */
+    unsigned long *funcHits;    /* [totalUserfuncs] */
+} coverage_counts;
+
+void avm_coverage_enable(char *path) {
+    coverage_path = path;
+}
+
+void avm_coverage_begin(void) {
+    if(!coverage_path) return;
+
+    /* pc may step one past the last instruction before the loop stops */
+    avm_coveragemap = (unsigned char *)calloc(vm.codeSize + 2, 1);
+
+    if(!avm_coveragemap)
+        fprintf(stderr, "Error: Cannot allocate coverage map\n");
+}
+
+void avm_coverage_cleanup(void) {
+    free(avm_coveragemap);
+    avm_coveragemap = NULL;
+}
+
+static int coverage_isbranch(vmopcode op) {
+    return (op >= jeq_v && op <= jgt_v) || (op >= jeq_nn_v && op <= jgt_nn_v);
+}
+
+/* Instructions without a line belong to the closest preceding line */
+static unsigned coverage_line(unsigned pc) {
+    while(pc >= 1 && !vm.code[pc].srcLine)
+        --pc;
+
+    return pc ? vm.code[pc].srcLine : 0;
+}
+
+static char *coverage_sourcename(char *binary) {
+    size_t len = strlen(binary);
+    char *source = (char *)malloc(len + 5);
+
+    strcpy(source, binary);
+
+    if(len > 4 && strcmp(binary + len - 4, ".abc") == 0)
+        strcpy(source + len - 4, ".asc");
+
+    return source;
+}
+
+/* Add the counts of an earlier report for the same binary */
+static void coverage_merge(coverage_counts *c, FILE *file) {
+    char line[1024];
+
+    while(fgets(line, sizeof(line), file)) {
+        unsigned srcLine, block, branch;
+        unsigned long hits;
+        char taken[32], name[512];
+
+        if(sscanf(line, "DA:%u,%lu", &srcLine, &hits) == 2) {
+            if(srcLine <= c->maxLine)
+                c->lineHits[srcLine] += hits;
+        }
+        else if(sscanf(line, "BRDA:%u,%u,%u,%31s", &srcLine, &block, &branch, taken) == 4) {
+            if(block > vm.codeSize || strcmp(taken, "-") == 0) continue;
+
+            c->branchSeen[block] = 1;
+            hits = strtoul(taken, NULL, 10);
+
+            if(branch == 0) c->taken[block] += hits;
+            else c->notTaken[block] += hits;
+        }
+        else if(sscanf(line, "FNDA:%lu,%511[^\n]", &hits, name) == 2) {
+            for(unsigned i = 0; i < vm.totalUserfuncs; ++i)
+                if(strcmp(vm.userfuncs[i].id, name) == 0)
+                    c->funcHits[i] += hits;
+        }
+    }
+}
+
+static void coverage_collect(coverage_counts *c) {
+    unsigned char *lineRun = (unsigned char *)calloc(c->maxLine + 1, 1);
+
+    for(unsigned pc = 1; pc <= vm.codeSize; ++pc) {
+        unsigned line = coverage_line(pc);
+        unsigned char bits = avm_coveragemap[pc];
+
+        c->lineCode[line] = 1;
+        if(bits) lineRun[line] = 1;
+
+        if(coverage_isbranch(vm.code[pc].opcode) && bits) {
+            c->branchSeen[pc] = 1;
+            c->taken[pc] += (bits & AVM_COVERAGE_JUMPED) != 0;
+            c->notTaken[pc] += (bits & AVM_COVERAGE_FALLTHROUGH) != 0;
+        }
+    }
+
+    for(unsigned line = 1; line <= c->maxLine; ++line)
+        c->lineHits[line] += lineRun[line];
+
+    /* calldirect skips the funcenter, so a function counts as entered when its body ran */
+    for(unsigned i = 0; i < vm.totalUserfuncs; ++i)
+        if(vm.userfuncs[i].address < vm.codeSize && avm_coveragemap[vm.userfuncs[i].address + 1])
+            ++c->funcHits[i];
+
+    free(lineRun);
+}
+
+static void coverage_report(coverage_counts *c, char *source, FILE *out) {
+    unsigned found = 0, hit = 0;
+
+    fprintf(out, "TN:\nSF:%s\n", source);
+
+    for(unsigned i = 0; i < vm.totalUserfuncs; ++i)
+        fprintf(out, "FN:%u,%s\n", coverage_line(vm.userfuncs[i].address), vm.userfuncs[i].id);
+
+    for(unsigned i = 0; i < vm.totalUserfuncs; ++i) {
+        fprintf(out, "FNDA:%lu,%s\n", c->funcHits[i], vm.userfuncs[i].id);
+        hit += c->funcHits[i] != 0;
+    }
+
+    fprintf(out, "FNF:%u\nFNH:%u\n", vm.totalUserfuncs, hit);
+
+    found = hit = 0;
+
+    for(unsigned pc = 1; pc <= vm.codeSize; ++pc) {
+        if(!coverage_isbranch(vm.code[pc].opcode)) continue;
+
+        unsigned line = coverage_line(pc);
+
+        if(c->branchSeen[pc]) {
+            fprintf(out, "BRDA:%u,%u,0,%lu\n", line, pc, c->taken[pc]);
+            fprintf(out, "BRDA:%u,%u,1,%lu\n", line, pc, c->notTaken[pc]);
+            hit += (c->taken[pc] != 0) + (c->notTaken[pc] != 0);
+        }
+        else {
+            fprintf(out, "BRDA:%u,%u,0,-\n", line, pc);
+            fprintf(out, "BRDA:%u,%u,1,-\n", line, pc);
+        }
+
+        found += 2;
+    }
+
+    fprintf(out, "BRF:%u\nBRH:%u\n", found, hit);
+
+    found = hit = 0;
+
+    for(unsigned line = 1; line <= c->maxLine; ++line) {
+        if(!c->lineCode[line]) continue;
+
+        fprintf(out, "DA:%u,%lu\n", line, c->lineHits[line]);
+        ++found;
+        hit += c->lineHits[line] != 0;
+    }
+
+    fprintf(out, "LF:%u\nLH:%u\nend_of_record\n", found, hit);
+}
+
+int avm_coverage_write(char *binary) {
+    if(!avm_coveragemap) return 1;
+
+    coverage_counts c;
+    c.maxLine = 0;
+
+    for(unsigned pc = 1; pc <= vm.codeSize; ++pc)
+        if(vm.code[pc].srcLine > c.maxLine)
+            c.maxLine = vm.code[pc].srcLine;
+
+    c.lineHits = (unsigned long *)calloc(c.maxLine + 1, sizeof(unsigned long));
+    c.lineCode = (unsigned char *)calloc(c.maxLine + 1, 1);
+    c.taken = (unsigned long *)calloc(vm.codeSize + 1, sizeof(unsigned long));
+    c.notTaken = (unsigned long *)calloc(vm.codeSize + 1, sizeof(unsigned long));
+    c.branchSeen = (unsigned char *)calloc(vm.codeSize + 1, 1);
+    c.funcHits = (unsigned long *)calloc(vm.totalUserfuncs + 1, sizeof(unsigned long));
+
+    FILE *previous = fopen(coverage_path, "r");
+
+    if(previous) {
+        coverage_merge(&c, previous);
+        fclose(previous);
+    }
+
+    coverage_collect(&c);
+
+    int status = 0;
+    FILE *out = fopen(coverage_path, "w");
+
+    if(out) {
+        char *source = coverage_sourcename(binary);
+        coverage_report(&c, source, out);
+        free(source);
+        fclose(out);
+    }
+    else {
+        fprintf(stderr, "Error: Cannot write coverage file '%s'\n", coverage_path);
+        status = 1;
+    }
+
+    free(c.lineHits);
+    free(c.lineCode);
+    free(c.taken);
+    free(c.notTaken);
+    free(c.branchSeen);
+    free(c.funcHits);
+    return status;
+}
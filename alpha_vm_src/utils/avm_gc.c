@@ -26,7 +26,7 @@ void avm_memcellclear(avm_memcell *m) {
 
 void memclear_string(avm_memcell *m) {
     assert(m->data.strVal);
-    free(m->data.strVal);
+    avm_stringdestroy(m->data.strVal);
 }
 
 void memclear_table(avm_memcell *m) {
@@ -0,0 +1,125 @@
+#include "../headers/avm_heapdump.h"
+#include "../headers/avm.h"
+#include "../../alpha_parser_src/headers/stack.h"
+
+/* Footprint of a table with its buckets and the strings it owns */
+static unsigned long heapdump_tablebytes(avm_table *t) {
+    unsigned long bytes = sizeof(avm_table);
+    avm_table_bucket **chains[2] = { t->strIndexed, t->numIndexed };
+
+    for(unsigned c = 0; c < 2; ++c) {
+        for(unsigned i = 0; i < AVM_TABLE_HASHSIZE; ++i) {
+            for(avm_table_bucket *b = chains[c][i]; b; b = b->next) {
+                bytes += sizeof(avm_table_bucket);
+
+                if(b->key.type == string_m) bytes += strlen(b->key.data.strVal) + 1;
+                if(b->value.type == string_m) bytes += strlen(b->value.data.strVal) + 1;
+            }
+        }
+    }
+
+    return bytes;
+}
+
+/* Mark everything reachable from t */
+static void heapdump_mark(avm_table *t, Stack *pending) {
+    if(t->dumpMark) return;
+
+    t->dumpMark = 1;
+    pushStack(pending, t);
+
+    while(!isEmptyStack(pending)) {
+        avm_table *curr = (avm_table *)popStack(pending);
+        avm_table_bucket **chains[2] = { curr->strIndexed, curr->numIndexed };
+
+        for(unsigned c = 0; c < 2; ++c) {
+            for(unsigned i = 0; i < AVM_TABLE_HASHSIZE; ++i) {
+                for(avm_table_bucket *b = chains[c][i]; b; b = b->next) {
+                    if(b->key.type == table_m && !b->key.data.tableVal->dumpMark) {
+                        b->key.data.tableVal->dumpMark = 1;
+                        pushStack(pending, b->key.data.tableVal);
+                    }
+
+                    if(b->value.type == table_m && !b->value.data.tableVal->dumpMark) {
+                        b->value.data.tableVal->dumpMark = 1;
+                        pushStack(pending, b->value.data.tableVal);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void heapdump_root(FILE *file, char *kind, unsigned slot, avm_memcell *m, Stack *pending) {
+    if(m->type != table_m) return;
+
+    fprintf(file, "R %s %u %u\n", kind, slot, m->data.tableVal->id);
+    heapdump_mark(m->data.tableVal, pending);
+}
+
+static void heapdump_table(FILE *file, avm_table *t) {
+    unsigned refs = 0;
+    avm_table_bucket **chains[2] = { t->strIndexed, t->numIndexed };
+
+    for(unsigned c = 0; c < 2; ++c)
+        for(unsigned i = 0; i < AVM_TABLE_HASHSIZE; ++i)
+            for(avm_table_bucket *b = chains[c][i]; b; b = b->next)
+                refs += (b->key.type == table_m) + (b->value.type == table_m);
+
+    fprintf(file, "T %u %u %u %lu %u %u", t->id, t->refCounter, t->total,
+            heapdump_tablebytes(t), (unsigned)t->dumpMark, refs);
+
+    for(unsigned c = 0; c < 2; ++c) {
+        for(unsigned i = 0; i < AVM_TABLE_HASHSIZE; ++i) {
+            for(avm_table_bucket *b = chains[c][i]; b; b = b->next) {
+                if(b->key.type == table_m) fprintf(file, " %u", b->key.data.tableVal->id);
+                if(b->value.type == table_m) fprintf(file, " %u", b->value.data.tableVal->id);
+            }
+        }
+    }
+
+    fprintf(file, "\n");
+}
+
+int avm_heapdump(char *path) {
+    FILE *file = fopen(path, "w");
+
+    if(!file) {
+        fprintf(stderr, "Error: Cannot write heap dump '%s'\n", path);
+        return 1;
+    }
+
+    Stack *pending = newStack();
+
+    for(avm_table *t = avm_livetables; t; t = t->regNext)
+        t->dumpMark = 0;
+
+    fprintf(file, "AVMHEAP %d\n", AVM_HEAPDUMP_VERSION);
+
+    if(vm.stack) {
+        unsigned globalsBase = AVM_STACKSIZE - vm.programVarCount;
+
+        for(unsigned i = AVM_STACKSIZE; i > globalsBase; --i)
+            heapdump_root(file, "global", AVM_STACKSIZE - i, &vm.stack[i], pending);
+
+        for(unsigned i = globalsBase; i > vm.top; --i)
+            heapdump_root(file, "stack", i, &vm.stack[i], pending);
+
+        for(unsigned i = vm.top; i >= 1; --i)
+            heapdump_root(file, "stale", i, &vm.stack[i], pending);
+    }
+
+    heapdump_root(file, "retval", 0, &vm.retval, pending);
+    heapdump_root(file, "register", 0, &vm.ax, pending);
+    heapdump_root(file, "register", 1, &vm.bx, pending);
+    heapdump_root(file, "register", 2, &vm.cx, pending);
+
+    for(avm_table *t = avm_livetables; t; t = t->regNext)
+        heapdump_table(file, t);
+
+    fprintf(file, "END\n");
+
+    destroyStack(pending);
+    fclose(file);
+    return 0;
+}
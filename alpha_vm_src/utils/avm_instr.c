@@ -3,6 +3,8 @@
 #include "../headers/avm_tables.h"
 #include "../headers/avm_libFunc.h"
 #include "../headers/avm.h"
+#include "../headers/avm_metrics.h"
+#include "../headers/avm_trace.h"
 #include "../../alpha_parser_src/headers/stack.h"
 
 execute_func_t executeFuncs[] = {
@@ -10,7 +12,18 @@ execute_func_t executeFuncs[] = {
     execute_uminus, execute_and, execute_or, execute_not, execute_jeq, execute_jne,
     execute_jle, execute_jge, execute_jlt, execute_jgt, execute_jump, execute_call,
     execute_pusharg, execute_funcenter, execute_funcexit, execute_newtable,
-    execute_tablegetelem, execute_tablesetelem, execute_nop
+    execute_tablegetelem, execute_tablesetelem, execute_tailcall, execute_calldirect, execute_add_nn,
+    execute_sub_nn, execute_mul_nn, execute_div_nn, execute_mod_nn, execute_jeq_nn,
+    execute_jne_nn, execute_jle_nn, execute_jge_nn, execute_jlt_nn, execute_jgt_nn,
+    execute_assign_num, execute_nop
+};
+
+char *opcodeStrings[] = {
+    "assign", "add", "sub", "mul", "div", "mod", "uminus", "and", "or", "not",
+    "jeq", "jne", "jle", "jge", "jlt", "jgt", "jump", "call", "pusharg",
+    "funcenter", "funcexit", "newtable", "tablegetelem", "tablesetelem", "tailcall",
+    "calldirect", "add_nn", "sub_nn", "mul_nn", "div_nn", "mod_nn", "jeq_nn", "jne_nn", "jle_nn", "jge_nn",
+    "jlt_nn", "jgt_nn", "assign_num", "nop"
 };
 
 double add_impl(double x, double y) {
@@ -57,7 +70,7 @@ unsigned char jgt_impl(double x, double y) {
 comparison_func_t comparisonFuncs[] = { jle_impl, jge_impl, jlt_impl, jgt_impl };
 
 void avm_initinstructions(void) {
-    assert(sizeof(executeFuncs) / sizeof(execute_func_t) == 25);
+    assert(sizeof(executeFuncs) / sizeof(execute_func_t) == 39);
     assert(sizeof(arithmeticFuncs) / sizeof(arithmetic_func_t) == 5);
     assert(sizeof(comparisonFuncs) / sizeof(comparison_func_t) == 4);
 }
@@ -136,6 +149,7 @@ void execute_not(instruction *instr) {
 
 void execute_jump(instruction *instr) {
     assert(instr->result->type == label_a);
+    AVM_SAFEPOINT();
     vm.pc = instr->result->val;
 }
 
@@ -239,9 +253,14 @@ void execute_jgt(instruction *instr) {
 }
 
 void execute_call(instruction *instr) {
+    AVM_SAFEPOINT();
+
     avm_memcell *func = avm_translate_operand(instr->arg1, &vm.ax);
     assert(func);
 
+    if(tracering.calls)
+        avm_trace_recordcall(func);
+
     if(vm.pc == 1 || vm.code[vm.pc - 1].opcode != pusharg_v) {
         vm.totalActuals = 0;
     }
@@ -322,13 +341,36 @@ void execute_funcenter(instruction *instr) {
     assert(func);
     assert(vm.pc == vm.userfuncs[func->data.funcVal].address);
 
-    userfunc_t *funcInfo = avm_getfuncinfo(vm.pc);
     vm.topsp = vm.top;
-    vm.top = vm.top - funcInfo->localSize;
+    vm.top = vm.top - vm.userfuncs[func->data.funcVal].localSize;
 
     vm.totalActuals = 0;
 }
 
+/*
+ * A call to a named function. The compiler put the address of its
+ * funcenter and its local count in the instruction, so the frame is set
+ * up here and the funcenter is skipped.
+ */
+void execute_calldirect(instruction *instr) {
+    AVM_SAFEPOINT();
+
+    if(tracering.calls)
+        avm_trace_recordcall(avm_translate_operand(instr->arg1, &vm.ax));
+
+    if(vm.pc == 1 || vm.code[vm.pc - 1].opcode != pusharg_v) {
+        vm.totalActuals = 0;
+    }
+
+    avm_callsaveenvironment();
+
+    vm.topsp = vm.top;
+    vm.top = vm.top - instr->arg2->val;
+    vm.pc = instr->result->val + 1;
+
+    assert(vm.code[instr->result->val].opcode == funcenter_v);
+}
+
 void execute_funcexit(instruction *unused) {
     unsigned oldTop = vm.top;
     vm.top = avm_get_envvalue(vm.topsp + AVM_SAVEDTOP_OFFSET);
@@ -339,6 +381,65 @@ void execute_funcexit(instruction *unused) {
         avm_memcellclear(&vm.stack[oldTop]);
 }
 
+/*
+ * A call whose result the calling function returns at once. A user
+ * function takes over the caller's frame: the arguments move to the top
+ * of it, the saved environment follows them, and the callee returns
+ * straight to where the caller would have. Any other callee is called as
+ * usual and the caller returns the result itself.
+ */
+void execute_tailcall(instruction *instr) {
+    avm_memcell *func = avm_translate_operand(instr->arg1, &vm.ax);
+    assert(func);
+
+    if(func->type != userfunc_m) {
+        execute_call(instr);
+        return;
+    }
+
+    AVM_SAFEPOINT();
+
+    if(tracering.calls)
+        avm_trace_recordcall(func);
+
+    if(vm.pc == 1 || vm.code[vm.pc - 1].opcode != pusharg_v) {
+        vm.totalActuals = 0;
+    }
+
+    /* func may be a local of the frame about to be reused */
+    unsigned address = vm.userfuncs[func->data.funcVal].address;
+    unsigned actuals = vm.totalActuals;
+    unsigned savedPc = avm_get_envvalue(vm.topsp + AVM_SAVEDPC_OFFSET);
+    unsigned savedTop = avm_get_envvalue(vm.topsp + AVM_SAVEDTOP_OFFSET);
+    unsigned savedTopsp = avm_get_envvalue(vm.topsp + AVM_SAVEDTOPSP_OFFSET);
+    unsigned topsp = savedTop - actuals - AVM_STACKENV_SIZE;
+
+    /* The arguments only move up, so the last one goes first */
+    for(unsigned i = actuals; i > 0; --i) {
+        avm_memcell *from = &vm.stack[vm.top + i];
+        avm_memcell *to = &vm.stack[topsp + AVM_STACKENV_SIZE + i];
+
+        avm_memcellclear(to);
+        *to = *from;
+        from->type = undef_m;
+    }
+
+    for(unsigned i = vm.top + 1; i <= topsp; ++i)
+        avm_memcellclear(&vm.stack[i]);
+
+    vm.top = topsp + AVM_STACKENV_SIZE;
+    avm_push_envvalue(actuals);
+    avm_push_envvalue(savedPc);
+    avm_push_envvalue(savedTop);
+    avm_push_envvalue(savedTopsp);
+
+    vm.totalActuals = 0;
+    vm.pc = address;
+
+    assert(vm.pc <= vm.codeSize);
+    assert(vm.code[vm.pc].opcode == funcenter_v);
+}
+
 void execute_newtable(instruction *instr) {
     avm_memcell *lv = avm_translate_operand(instr->result, (avm_memcell *)0);
     assert(lv && ((lv >= &vm.stack[1] && lv <= &vm.stack[AVM_STACKSIZE]) || lv == &vm.retval));
@@ -387,6 +488,88 @@ void execute_tablesetelem(instruction *instr) {
     }
 }
 
+/*
+ * The typed forms. The compiler proved that every operand they read is a
+ * number, so the tags are not looked at; division and modulo still stop
+ * on a zero divisor.
+ */
+static void assign_number(avm_memcell *lv, double val) {
+    if(lv->type != number_m) avm_memcellclear(lv);
+    lv->type = number_m;
+    lv->data.numVal = val;
+}
+
+void execute_arithmetic_nn(instruction *instr) {
+    avm_memcell *lv = avm_translate_operand(instr->result, (avm_memcell *)0);
+    avm_memcell *rv1 = avm_translate_operand(instr->arg1, &vm.ax);
+    avm_memcell *rv2 = avm_translate_operand(instr->arg2, &vm.bx);
+
+    assert(lv && ((lv >= &vm.stack[1] && lv <= &vm.stack[AVM_STACKSIZE]) || lv == &vm.retval));
+    assert(rv1->type == number_m && rv2->type == number_m);
+
+    arithmetic_func_t op = arithmeticFuncs[instr->opcode - add_nn_v];
+    assign_number(lv, (*op)(rv1->data.numVal, rv2->data.numVal));
+}
+
+void execute_add_nn(instruction *instr) {
+    execute_arithmetic_nn(instr);
+}
+void execute_sub_nn(instruction *instr) {
+    execute_arithmetic_nn(instr);
+}
+void execute_mul_nn(instruction *instr) {
+    execute_arithmetic_nn(instr);
+}
+void execute_div_nn(instruction *instr) {
+    execute_arithmetic_nn(instr);
+}
+void execute_mod_nn(instruction *instr) {
+    execute_arithmetic_nn(instr);
+}
+
+void execute_jeq_nn(instruction *instr) {
+    avm_memcell *rv1 = avm_translate_operand(instr->arg1, &vm.ax);
+    avm_memcell *rv2 = avm_translate_operand(instr->arg2, &vm.bx);
+
+    assert(rv1->type == number_m && rv2->type == number_m);
+    if((rv1->data.numVal == rv2->data.numVal) == (instr->opcode == jeq_nn_v))
+        vm.pc = instr->result->val;
+}
+
+void execute_jne_nn(instruction *instr) {
+    execute_jeq_nn(instr);
+}
+
+void execute_jle_nn(instruction *instr) {
+    avm_memcell *rv1 = avm_translate_operand(instr->arg1, &vm.ax);
+    avm_memcell *rv2 = avm_translate_operand(instr->arg2, &vm.bx);
+    comparison_func_t op = comparisonFuncs[instr->opcode - jle_nn_v];
+
+    assert(rv1->type == number_m && rv2->type == number_m);
+    if((*op)(rv1->data.numVal, rv2->data.numVal))
+        vm.pc = instr->result->val;
+}
+
+void execute_jge_nn(instruction *instr) {
+    execute_jle_nn(instr);
+}
+void execute_jlt_nn(instruction *instr) {
+    execute_jle_nn(instr);
+}
+void execute_jgt_nn(instruction *instr) {
+    execute_jle_nn(instr);
+}
+
+void execute_assign_num(instruction *instr) {
+    avm_memcell *lv = avm_translate_operand(instr->result, (avm_memcell *)0);
+    avm_memcell *rv = avm_translate_operand(instr->arg1, &vm.ax);
+
+    assert(lv && ((lv >= &vm.stack[0] && lv <= &vm.stack[AVM_STACKSIZE]) || lv == &vm.retval));
+    assert(rv->type == number_m);
+
+    assign_number(lv, rv->data.numVal);
+}
+
 void execute_nop(instruction *instr) { /* Empty */ }
 
 /* Stack for saving env base addr */
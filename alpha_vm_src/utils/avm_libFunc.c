@@ -2,6 +2,9 @@
 #include "../headers/avm_memcell.h"
 #include "../headers/avm_tables.h"
 #include "../headers/avm.h"
+#include "../headers/avm_stats.h"
+#include "../headers/avm_heapdump.h"
+#include "../headers/avm_trace.h"
 #include "../../alpha_parser_src/headers/stack.h"
 #include <math.h>
 #include <ctype.h>
@@ -126,6 +129,9 @@ void avm_initlibraryfuncs(void) {
     avm_registerlibfunc("sqrt", libfunc_sqrt);
     avm_registerlibfunc("cos", libfunc_cos);
     avm_registerlibfunc("sin", libfunc_sin);
+    avm_registerlibfunc("vmstats", libfunc_vmstats);
+    avm_registerlibfunc("heapdump", libfunc_heapdump);
+    avm_registerlibfunc("tracedump", libfunc_tracedump);
 }
 
 unsigned avm_totalactuals(void) {
@@ -185,7 +191,7 @@ void libfunc_input(void) {
                 vm.retval.data.numVal = num;
             } else {
                 vm.retval.type = string_m;
-                vm.retval.data.strVal = strdup(buffer);
+                vm.retval.data.strVal = avm_stringnew(buffer);
             }
         }
     } else {
@@ -461,7 +467,7 @@ void libfunc_typeof(void) {
     avm_memcell *arg = avm_getactual(0);
     avm_memcellclear(&vm.retval);
     vm.retval.type = string_m;
-    vm.retval.data.strVal = strdup(typeStrings[arg->type]);
+    vm.retval.data.strVal = avm_stringnew(typeStrings[arg->type]);
 }
 
 void libfunc_strtonum(void) {
@@ -573,4 +579,70 @@ void libfunc_sin(void) {
     double radians = degrees * M_PI / 180.0;
     vm.retval.type = number_m;
     vm.retval.data.numVal = sin(radians);
+}
+
+/* Helper for vmstats: t[key] = number */
+static void vmstats_setnum(avm_table *t, char *key, unsigned long val) {
+    avm_memcell index_cell, value_cell;
+
+    index_cell.type = string_m;
+    index_cell.data.strVal = key;
+    value_cell.type = number_m;
+    value_cell.data.numVal = (double)val;
+
+    avm_tablesetelem(t, &index_cell, &value_cell);
+}
+
+void libfunc_vmstats(void) {
+    unsigned n = avm_totalactuals();
+
+    if(n != 0) {
+        avm_error("no arguments (not %d) expected in 'vmstats'!", n);
+        return;
+    }
+
+    /* snapshot first, so the result table does not count itself */
+    avm_memstats snapshot = memstats;
+
+    avm_memcellclear(&vm.retval);
+    vm.retval.type = table_m;
+    vm.retval.data.tableVal = avm_tablenew();
+    avm_tableincrefcounter(vm.retval.data.tableVal);
+
+    avm_table *t = vm.retval.data.tableVal;
+    vmstats_setnum(t, "livetables", snapshot.liveTables);
+    vmstats_setnum(t, "livebuckets", snapshot.liveBuckets);
+    vmstats_setnum(t, "livestringbytes", snapshot.liveStringBytes);
+    vmstats_setnum(t, "heapbytes", snapshot.heapBytes);
+    vmstats_setnum(t, "peakheapbytes", snapshot.peakHeapBytes);
+    vmstats_setnum(t, "refincrements", snapshot.refIncrements);
+    vmstats_setnum(t, "refdecrements", snapshot.refDecrements);
+}
+
+void libfunc_heapdump(void) {
+    unsigned n = avm_totalactuals();
+
+    if(n != 1) {
+        avm_error("one argument (not %d) expected in 'heapdump'!", n);
+        return;
+    }
+
+    avm_memcell *arg = avm_getactual(0);
+
+    if(arg->type != string_m) {
+        avm_error("argument to 'heapdump' must be a string!");
+        return;
+    }
+
+    avm_memcellclear(&vm.retval);
+    vm.retval.type = bool_m;
+    vm.retval.data.boolVal = (avm_heapdump(arg->data.strVal) == 0);
+}
+
+void libfunc_tracedump(void) {
+    avm_trace_dump(stderr);
+
+    avm_memcellclear(&vm.retval);
+    vm.retval.type = bool_m;
+    vm.retval.data.boolVal = tracering.instrs != NULL;
 }
\ No newline at end of file
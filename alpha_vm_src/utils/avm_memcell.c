@@ -1,6 +1,8 @@
 #include "../headers/avm_memcell.h"
 #include "../headers/avm_tables.h"
 #include "../headers/avm.h"
+#include "../headers/avm_stats.h"
+#include "../headers/avm_trace.h"
 #include <stdarg.h>
 #include <limits.h>
 
@@ -48,6 +50,28 @@ tobool_func_t toboolFuncs[] = {
 /* Memory cell cleanup - forward declaration */
 extern void avm_memcellclear(avm_memcell *m);
 
+/* Allocate / release the string content of a memory cell */
+char *avm_stringnew(char *s) {
+    unsigned long bytes = strlen(s) + 1;
+    char *copy = (char*)malloc(bytes);
+    assert(copy);
+    memcpy(copy, s, bytes);
+
+    memstats.liveStringBytes += bytes;
+    avm_memstats_alloc(bytes);
+
+    return copy;
+}
+
+void avm_stringdestroy(char *s) {
+    unsigned long bytes = strlen(s) + 1;
+
+    memstats.liveStringBytes -= bytes;
+    avm_memstats_free(bytes);
+
+    free(s);
+}
+
 /* Assign one memory cell to another */
 void avm_assign(avm_memcell *lv, avm_memcell *rv) {
     if(lv == rv) return;
@@ -59,7 +83,7 @@ void avm_assign(avm_memcell *lv, avm_memcell *rv) {
 
     memcpy(lv, rv, sizeof(avm_memcell));
 
-    if(lv->type == string_m) lv->data.strVal = strdup(rv->data.strVal);
+    if(lv->type == string_m) lv->data.strVal = avm_stringnew(rv->data.strVal);
     else if(lv->type == table_m) avm_tableincrefcounter(lv->data.tableVal);
 }
 
@@ -155,4 +179,5 @@ void avm_error(char *format, ...) {
     vm.executionFinished = 1;
 
     va_end(args);
+    avm_trace_dump(stderr);
 }
\ No newline at end of file
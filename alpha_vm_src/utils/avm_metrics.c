@@ -0,0 +1,107 @@
+#include "../headers/avm_metrics.h"
+#include "../headers/avm_stats.h"
+
+volatile sig_atomic_t avm_metricsrequested = 0;
+unsigned long avm_opcodecounts[AVM_MAX_INSTRUCTIONS + 1];
+
+static char *metrics_path = NULL;
+
+static void metrics_handler(int signum) {
+    (void)signum;
+    avm_metricsrequested = 1;
+}
+
+void avm_metrics_install(char *path) {
+    struct sigaction action;
+
+    metrics_path = path;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = metrics_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+
+    sigaction(SIGUSR1, &action, NULL);
+}
+
+/* The innermost funcenter whose funcexit has not been passed yet */
+static char *metrics_currentfunction(void) {
+    unsigned nested = 0;
+    unsigned pc = vm.pc <= vm.codeSize ? vm.pc : vm.codeSize;
+
+    for(unsigned i = pc; i >= 1; --i) {
+        if(vm.code[i].opcode == funcexit_v && i != pc) {
+            ++nested;
+        }
+        else if(vm.code[i].opcode == funcenter_v) {
+            if(!nested) {
+                userfunc_t *f = avm_getfuncinfo(i);
+                return f && f->id ? f->id : "?";
+            }
+
+            --nested;
+        }
+    }
+
+    return "$main";
+}
+
+/* Number of active frames, following the saved topsp chain */
+static unsigned metrics_calldepth(void) {
+    unsigned base = AVM_STACKSIZE - vm.programVarCount;
+    unsigned topsp = vm.topsp;
+    unsigned depth = 0;
+
+    while(topsp != base && topsp < AVM_STACKSIZE && depth < AVM_STACKSIZE) {
+        avm_memcell *saved = &vm.stack[topsp + AVM_SAVEDTOPSP_OFFSET];
+
+        if(saved->type != number_m) break;
+
+        topsp = (unsigned)saved->data.numVal;
+        ++depth;
+    }
+
+    return depth;
+}
+
+void avm_metrics_dump(FILE *out) {
+    unsigned long executed = 0;
+
+    for(unsigned i = 0; i <= AVM_MAX_INSTRUCTIONS; ++i)
+        executed += avm_opcodecounts[i];
+
+    fprintf(out, "{\"instructions\": %lu, \"function\": \"%s\", \"line\": %u, \"pc\": %u, "
+            "\"call_depth\": %u, ", executed, metrics_currentfunction(), vm.currLine, vm.pc,
+            metrics_calldepth());
+
+    fprintf(out, "\"heap\": {\"live_tables\": %lu, \"live_buckets\": %lu, "
+            "\"live_string_bytes\": %lu, \"heap_bytes\": %lu, \"peak_heap_bytes\": %lu, "
+            "\"allocations\": %lu}, ",
+            memstats.liveTables, memstats.liveBuckets, memstats.liveStringBytes,
+            memstats.heapBytes, memstats.peakHeapBytes, memstats.allocations);
+
+    fprintf(out, "\"opcodes\": {");
+
+    for(unsigned i = 0; i <= AVM_MAX_INSTRUCTIONS; ++i)
+        fprintf(out, "%s\"%s\": %lu", i ? ", " : "", opcodeStrings[i], avm_opcodecounts[i]);
+
+    fprintf(out, "}}\n");
+    fflush(out);
+}
+
+void avm_metrics_safepoint(void) {
+    FILE *out = stderr;
+
+    avm_metricsrequested = 0;
+
+    if(metrics_path && !(out = fopen(metrics_path, "a"))) {
+        fprintf(stderr, "Error: Cannot write metrics to '%s'\n", metrics_path);
+        out = stderr;
+    }
+
+    fflush(stdout);
+    avm_metrics_dump(out);
+
+    if(out != stderr)
+        fclose(out);
+}
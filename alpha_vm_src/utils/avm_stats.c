@@ -0,0 +1,28 @@
+#include "../headers/avm_stats.h"
+
+avm_memstats memstats;
+
+void avm_memstats_alloc(unsigned long bytes) {
+    memstats.heapBytes += bytes;
+    ++memstats.allocations;
+
+    if(memstats.heapBytes > memstats.peakHeapBytes)
+        memstats.peakHeapBytes = memstats.heapBytes;
+}
+
+void avm_memstats_free(unsigned long bytes) {
+    memstats.heapBytes -= bytes;
+}
+
+void avm_memstats_print(FILE *out) {
+    fprintf(out, "========== AVM MEMORY STATISTICS ==========\n");
+    fprintf(out, "%-22s %lu\n", "live tables:", memstats.liveTables);
+    fprintf(out, "%-22s %lu\n", "live buckets:", memstats.liveBuckets);
+    fprintf(out, "%-22s %lu\n", "live string bytes:", memstats.liveStringBytes);
+    fprintf(out, "%-22s %lu\n", "heap bytes:", memstats.heapBytes);
+    fprintf(out, "%-22s %lu\n", "peak heap bytes:", memstats.peakHeapBytes);
+    fprintf(out, "%-22s %lu\n", "allocations:", memstats.allocations);
+    fprintf(out, "%-22s %lu\n", "refcount increments:", memstats.refIncrements);
+    fprintf(out, "%-22s %lu\n", "refcount decrements:", memstats.refDecrements);
+    fprintf(out, "===========================================\n");
+}
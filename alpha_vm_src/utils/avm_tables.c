@@ -1,10 +1,15 @@
 #include "../headers/avm_tables.h"
 #include "../headers/avm_memcell.h"
+#include "../headers/avm_stats.h"
 #include <assert.h>
+#include <stdint.h>
 
 extern void avm_memcellclear(avm_memcell *m);
 extern void avm_assign(avm_memcell *lv, avm_memcell *rv);
 
+avm_table *avm_livetables = NULL;
+static unsigned avm_tableserial = 0;
+
 /* Create a new table */
 avm_table *avm_tablenew(void) {
     avm_table *t = (avm_table*)malloc(sizeof(avm_table));
@@ -16,6 +21,18 @@ avm_table *avm_tablenew(void) {
     memset(t->strIndexed, 0, AVM_TABLE_HASHSIZE * sizeof(avm_table_bucket*));
     memset(t->numIndexed, 0, AVM_TABLE_HASHSIZE * sizeof(avm_table_bucket*));
 
+    t->id = ++avm_tableserial;
+    t->dumpMark = 0;
+    t->regPrev = NULL;
+    t->regNext = avm_livetables;
+
+    if(avm_livetables) avm_livetables->regPrev = t;
+
+    avm_livetables = t;
+
+    ++memstats.liveTables;
+    avm_memstats_alloc(sizeof(avm_table));
+
     return t;
 }
 
@@ -48,6 +65,14 @@ void avm_tabledestroy(avm_table *t) {
         }
     }
 
+    if(t->regPrev) t->regPrev->regNext = t->regNext;
+    else avm_livetables = t->regNext;
+
+    if(t->regNext) t->regNext->regPrev = t->regPrev;
+
+    --memstats.liveTables;
+    avm_memstats_free(sizeof(avm_table));
+
     free(t);
 }
 
@@ -55,12 +80,14 @@ void avm_tabledestroy(avm_table *t) {
 void avm_tableincrefcounter(avm_table *t) {
     assert(t);
     ++t->refCounter;
+    ++memstats.refIncrements;
 }
 
 /* Decrement table reference counter and destroy if needed */
 void avm_tabledecrefcounter(avm_table *t) {
     assert(t);
     assert(t->refCounter > 0);
+    ++memstats.refDecrements;
 
     if(--t->refCounter == 0) avm_tabledestroy(t);
 }
@@ -315,6 +342,9 @@ avm_table_bucket *avm_tablebucket_create(avm_memcell *key, avm_memcell *value) {
 
     bucket->next = NULL;
 
+    ++memstats.liveBuckets;
+    avm_memstats_alloc(sizeof(avm_table_bucket));
+
     return bucket;
 }
 
@@ -324,6 +354,9 @@ void avm_tablebucket_destroy(avm_table_bucket *bucket) {
     avm_memcellclear(&bucket->key);
     avm_memcellclear(&bucket->value);
 
+    --memstats.liveBuckets;
+    avm_memstats_free(sizeof(avm_table_bucket));
+
     free(bucket);
 }
 
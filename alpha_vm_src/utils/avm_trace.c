@@ -0,0 +1,102 @@
+#include "../headers/avm_trace.h"
+#include <signal.h>
+
+avm_trace tracering;
+
+static char *traceArgStrings[] = {
+    "label", "global", "formal", "local", "number", "string",
+    "bool", "nil", "userfunc", "libfunc", "retval"
+};
+
+static unsigned trace_roundup(unsigned n) {
+    unsigned size = 1;
+
+    while(size < n && size < (1u << 30))
+        size <<= 1;
+
+    return size;
+}
+
+/* Assertion failures abort(): print the rings, then let the signal through */
+static void trace_abort_handler(int signum) {
+    avm_trace_dump(stderr);
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
+
+void avm_trace_initialize(unsigned instrs, unsigned calls) {
+    unsigned instrSize = trace_roundup(instrs);
+    unsigned callSize = trace_roundup(calls);
+
+    tracering.instrs = (avm_trace_instr *)calloc(instrSize, sizeof(avm_trace_instr));
+    tracering.calls = (avm_trace_call *)calloc(callSize, sizeof(avm_trace_call));
+
+    if(!tracering.instrs || !tracering.calls) {
+        fprintf(stderr, "Error: Cannot allocate trace buffers\n");
+        avm_trace_cleanup();
+        return;
+    }
+
+    tracering.instrMask = instrSize - 1;
+    tracering.callMask = callSize - 1;
+    tracering.totalInstrs = 0;
+    tracering.totalCalls = 0;
+
+    signal(SIGABRT, trace_abort_handler);
+}
+
+void avm_trace_cleanup(void) {
+    free(tracering.instrs);
+    free(tracering.calls);
+    tracering.instrs = NULL;
+    tracering.calls = NULL;
+}
+
+static char *trace_argstring(unsigned char type) {
+    if(type == AVM_TRACE_NOARG || type >= sizeof(traceArgStrings) / sizeof(traceArgStrings[0]))
+        return "-";
+
+    return traceArgStrings[type];
+}
+
+static void trace_dumpcall(FILE *out, avm_trace_call *e) {
+    fprintf(out, "  pc %-6u line %-5u ", e->pc, e->line);
+
+    if(e->type == userfunc_m && e->func < vm.totalUserfuncs)
+        fprintf(out, "%s (user function at %u)\n", vm.userfuncs[e->func].id,
+                vm.userfuncs[e->func].address);
+    else if(e->type == libfunc_m)
+        fprintf(out, "%s (library function)\n", e->name);
+    else
+        fprintf(out, "<%s value>\n", typeStrings[e->type]);
+}
+
+void avm_trace_dump(FILE *out) {
+    if(!tracering.instrs) return;
+
+    unsigned long instrs = tracering.totalInstrs;
+    unsigned long calls = tracering.totalCalls;
+    unsigned long firstInstr = instrs > tracering.instrMask ? instrs - tracering.instrMask - 1 : 0;
+    unsigned long firstCall = calls > tracering.callMask ? calls - tracering.callMask - 1 : 0;
+
+    fflush(stdout);
+    fprintf(out, "========== AVM EXECUTION TRACE ==========\n");
+    fprintf(out, "last %lu of %lu instructions:\n", instrs - firstInstr, instrs);
+
+    for(unsigned long i = firstInstr; i < instrs; ++i) {
+        avm_trace_instr *e = &tracering.instrs[i & tracering.instrMask];
+
+        fprintf(out, "  pc %-6u line %-5u %-13s %-8s %-8s %s\n", e->pc, e->line,
+                e->opcode <= AVM_MAX_INSTRUCTIONS ? opcodeStrings[e->opcode] : "?",
+                trace_argstring(e->types[0]), trace_argstring(e->types[1]),
+                trace_argstring(e->types[2]));
+    }
+
+    fprintf(out, "last %lu of %lu calls:\n", calls - firstCall, calls);
+
+    for(unsigned long i = firstCall; i < calls; ++i)
+        trace_dumpcall(out, &tracering.calls[i & tracering.callMask]);
+
+    fprintf(out, "=========================================\n");
+    fflush(out);
+}
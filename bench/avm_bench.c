@@ -0,0 +1,380 @@
+/*
+ * avm_bench - run compiled Alpha programs under the VM and report
+ * wall time, instructions/sec, peak RSS and allocation counts.
+ *
+ * Every program runs several times; runs further than 3 MADs from the
+ * median wall time are dropped before averaging. Output of each run is
+ * checked against <program>.expected when that file exists.
+ *
+ *   avm_bench [--runs=N] [--avm=path] [--out=file] [--baseline=file] prog.abc...
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define BENCH_MAX_RUNS 100
+#define BENCH_NAME_MAX 128
+
+typedef struct bench_result {
+    char name[BENCH_NAME_MAX];
+    unsigned runs;
+    unsigned kept;
+    double wallMedian;
+    double wallMean;
+    double wallMin;
+    double wallMax;
+    unsigned long instructions;
+    double ips;
+    long peakRssKb;
+    unsigned long allocations;
+    unsigned long peakHeapBytes;
+} bench_result;
+
+static char *avm_path = "./avm";
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double bench_median(double *values, unsigned n) {
+    double sorted[BENCH_MAX_RUNS];
+
+    memcpy(sorted, values, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), bench_compare_doubles);
+
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+/* Strip directory and extension: bench/vm/queens.abc -> queens */
+static void bench_name(char *path, char *name) {
+    char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    snprintf(name, BENCH_NAME_MAX, "%s", base);
+
+    char *dot = strrchr(name, '.');
+    if(dot) *dot = '\0';
+}
+
+/* Path next to the program with its extension replaced */
+static char *bench_sibling(char *path, char *ext) {
+    size_t len = strlen(path);
+    char *dot = strrchr(path, '.');
+    char *sibling = (char *)malloc(len + strlen(ext) + 1);
+
+    if(dot && !strchr(dot, '/')) len = dot - path;
+
+    memcpy(sibling, path, len);
+    strcpy(sibling + len, ext);
+    return sibling;
+}
+
+static char *bench_readfile(char *path) {
+    FILE *file = fopen(path, "rb");
+    if(!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *data = (char *)malloc(size + 1);
+    data[fread(data, 1, size, file)] = '\0';
+    fclose(file);
+    return data;
+}
+
+/* Find "key": <number> anywhere after from */
+static int bench_jsonfield(char *from, char *key, double *value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+
+    char *field = strstr(from, pattern);
+    if(!field) return 0;
+
+    *value = strtod(field + strlen(pattern), NULL);
+    return 1;
+}
+
+/* One VM run; returns 0 and fills wall/rss on a clean exit */
+static int bench_runonce(char *program, char *outPath, char *statsPath, double *wall, long *rssKb) {
+    char statsArg[4096];
+    snprintf(statsArg, sizeof(statsArg), "--stats-json=%s", statsPath);
+
+    double start = bench_now();
+    pid_t pid = fork();
+
+    if(pid < 0) {
+        perror("fork");
+        return 1;
+    }
+
+    if(pid == 0) {
+        int out = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int null = open("/dev/null", O_WRONLY);
+
+        if(out < 0 || null < 0) _exit(127);
+
+        dup2(out, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execl(avm_path, avm_path, statsArg, program, (char *)NULL);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+
+    if(wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4");
+        return 1;
+    }
+
+    *wall = bench_now() - start;
+    *rssKb = usage.ru_maxrss;
+
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: VM exited abnormally (status %d)\n", program, status);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int bench_program(char *program, unsigned runs, bench_result *r) {
+    double walls[BENCH_MAX_RUNS];
+    char *outPath = bench_sibling(program, ".out");
+    char *statsPath = bench_sibling(program, ".stats.json");
+    char *expectedPath = bench_sibling(program, ".expected");
+    char *expected = bench_readfile(expectedPath);
+    int status = 0;
+
+    memset(r, 0, sizeof(*r));
+    bench_name(program, r->name);
+    r->runs = runs;
+
+    for(unsigned i = 0; i < runs && !status; ++i) {
+        long rssKb;
+
+        if(bench_runonce(program, outPath, statsPath, &walls[i], &rssKb)) {
+            status = 1;
+            break;
+        }
+
+        if(rssKb > r->peakRssKb) r->peakRssKb = rssKb;
+
+        if(expected) {
+            char *actual = bench_readfile(outPath);
+
+            if(!actual || strcmp(actual, expected) != 0) {
+                fprintf(stderr, "%s: output differs from %s\n", program, expectedPath);
+                status = 1;
+            }
+
+            free(actual);
+        }
+    }
+
+    if(!status) {
+        char *stats = bench_readfile(statsPath);
+        double value;
+
+        if(!stats) {
+            fprintf(stderr, "%s: VM wrote no stats to %s\n", program, statsPath);
+            status = 1;
+        }
+        else {
+            if(bench_jsonfield(stats, "instructions", &value)) r->instructions = (unsigned long)value;
+            if(bench_jsonfield(stats, "allocations", &value)) r->allocations = (unsigned long)value;
+            if(bench_jsonfield(stats, "peak_heap_bytes", &value)) r->peakHeapBytes = (unsigned long)value;
+            free(stats);
+        }
+    }
+
+    if(!status) {
+        double median = bench_median(walls, runs);
+        double deviations[BENCH_MAX_RUNS];
+
+        for(unsigned i = 0; i < runs; ++i)
+            deviations[i] = fabs(walls[i] - median);
+
+        double mad = bench_median(deviations, runs);
+        double sum = 0;
+
+        r->wallMedian = median;
+        r->wallMin = r->wallMax = median;
+
+        for(unsigned i = 0; i < runs; ++i) {
+            if(deviations[i] > 3 * mad && mad > 0) continue;
+
+            sum += walls[i];
+            ++r->kept;
+
+            if(walls[i] < r->wallMin) r->wallMin = walls[i];
+            if(walls[i] > r->wallMax) r->wallMax = walls[i];
+        }
+
+        r->wallMean = sum / r->kept;
+        r->ips = r->wallMean > 0 ? r->instructions / r->wallMean : 0;
+    }
+
+    remove(outPath);
+    remove(statsPath);
+    free(outPath);
+    free(statsPath);
+    free(expectedPath);
+    free(expected);
+    return status;
+}
+
+static void bench_writejson(FILE *out, bench_result *results, unsigned n) {
+    fprintf(out, "{\"benchmarks\": [\n");
+
+    for(unsigned i = 0; i < n; ++i) {
+        bench_result *r = &results[i];
+
+        fprintf(out, "  {\"name\": \"%s\", \"runs\": %u, \"kept\": %u, \"wall_median\": %.6f, "
+                "\"wall_mean\": %.6f, \"wall_min\": %.6f, \"wall_max\": %.6f, "
+                "\"instructions\": %lu, \"ips\": %.0f, \"peak_rss_kb\": %ld, "
+                "\"allocations\": %lu, \"peak_heap_bytes\": %lu}%s\n",
+                r->name, r->runs, r->kept, r->wallMedian, r->wallMean, r->wallMin, r->wallMax,
+                r->instructions, r->ips, r->peakRssKb, r->allocations, r->peakHeapBytes,
+                i + 1 < n ? "," : "");
+    }
+
+    fprintf(out, "]}\n");
+}
+
+/* Baseline files are our own output: one benchmark object per line */
+static int bench_baseline(char *baseline, char *name, bench_result *r) {
+    char pattern[BENCH_NAME_MAX + 16];
+    snprintf(pattern, sizeof(pattern), "\"name\": \"%s\"", name);
+
+    char *line = strstr(baseline, pattern);
+    if(!line) return 0;
+
+    char *end = strchr(line, '\n');
+    double value;
+
+    if(end) *end = '\0';
+
+    memset(r, 0, sizeof(*r));
+    if(bench_jsonfield(line, "wall_mean", &value)) r->wallMean = value;
+    if(bench_jsonfield(line, "ips", &value)) r->ips = value;
+    if(bench_jsonfield(line, "peak_rss_kb", &value)) r->peakRssKb = (long)value;
+    if(bench_jsonfield(line, "allocations", &value)) r->allocations = (unsigned long)value;
+
+    if(end) *end = '\n';
+    return 1;
+}
+
+static double bench_delta(double now, double before) {
+    return before != 0 ? 100.0 * (now - before) / before : 0;
+}
+
+static void bench_print(bench_result *results, unsigned n, char *baseline) {
+    printf("%-14s %10s %6s %14s %12s %12s\n",
+           "benchmark", "wall (s)", "kept", "instr/s", "peak RSS KB", "allocations");
+
+    for(unsigned i = 0; i < n; ++i) {
+        bench_result *r = &results[i], base;
+
+        printf("%-14s %10.4f %3u/%-2u %14.0f %12ld %12lu\n", r->name, r->wallMean,
+               r->kept, r->runs, r->ips, r->peakRssKb, r->allocations);
+
+        if(baseline && bench_baseline(baseline, r->name, &base))
+            printf("%-14s %+9.1f%% %6s %+13.1f%% %+11.1f%% %+11.1f%%\n", "  vs baseline",
+                   bench_delta(r->wallMean, base.wallMean), "",
+                   bench_delta(r->ips, base.ips),
+                   bench_delta(r->peakRssKb, base.peakRssKb),
+                   bench_delta(r->allocations, base.allocations));
+    }
+}
+
+static void bench_usage(char *program) {
+    fprintf(stderr, "Usage: %s [--runs=N] [--avm=path] [--out=file] [--baseline=file] "
+            "program.abc...\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned runs = 7;
+    char *outPath = NULL;
+    char *baselinePath = NULL;
+    char *baseline = NULL;
+    bench_result *results = (bench_result *)calloc(argc, sizeof(bench_result));
+    unsigned n = 0;
+    int status = 0;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = (unsigned)atoi(argv[i] + 7);
+
+            if(runs < 1 || runs > BENCH_MAX_RUNS) {
+                fprintf(stderr, "Error: --runs must be between 1 and %d\n", BENCH_MAX_RUNS);
+                return 1;
+            }
+        }
+        else if(strncmp(argv[i], "--avm=", 6) == 0)
+            avm_path = argv[i] + 6;
+        else if(strncmp(argv[i], "--out=", 6) == 0)
+            outPath = argv[i] + 6;
+        else if(strncmp(argv[i], "--baseline=", 11) == 0)
+            baselinePath = argv[i] + 11;
+        else if(argv[i][0] == '-') {
+            bench_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(baselinePath && !(baseline = bench_readfile(baselinePath))) {
+        fprintf(stderr, "Error: Cannot read baseline '%s'\n", baselinePath);
+        return 1;
+    }
+
+    for(int i = 1; i < argc; ++i) {
+        if(argv[i][0] == '-') continue;
+
+        if(bench_program(argv[i], runs, &results[n]) == 0)
+            ++n;
+        else
+            status = 1;
+    }
+
+    if(!n) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    bench_print(results, n, baseline);
+
+    if(outPath) {
+        FILE *out = fopen(outPath, "w");
+
+        if(out) {
+            bench_writejson(out, results, n);
+            fclose(out);
+            printf("\nResults written to %s\n", outPath);
+        }
+        else {
+            fprintf(stderr, "Error: Cannot write results to '%s'\n", outPath);
+            status = 1;
+        }
+    }
+
+    free(baseline);
+    free(results);
+    return status;
+}
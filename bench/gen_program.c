@@ -0,0 +1,213 @@
+/*
+ * gen_program - write a synthetic Alpha program of about <lines> lines.
+ *
+ * The program is a stream of units picked at random: functions with
+ * nested if/while/for bodies, long arithmetic and boolean expressions,
+ * big table literals and calls to earlier functions. It is meant for
+ * compiling, not running.
+ *
+ *   gen_program <lines> [--depth=N] [--terms=N] [--table=N] [--seed=N] > out.asc
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+static unsigned long lines = 0;
+static unsigned long functions = 0;
+static unsigned long tables = 0;
+static unsigned long globals = 0;
+
+static unsigned maxDepth = 12;
+static unsigned exprTerms = 40;
+static unsigned tableEntries = 64;
+
+static unsigned long long rngState = 88172645463325252ULL;
+
+static unsigned gen_random(unsigned bound) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (unsigned)(rngState % bound);
+}
+
+static void gen_line(unsigned indent, char *format, ...) {
+    va_list args;
+
+    for(unsigned i = 0; i < indent; ++i) fputs("    ", stdout);
+
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+
+    putchar('\n');
+    ++lines;
+}
+
+/* A global that already exists, or a new one */
+static unsigned long gen_global(void) {
+    if(!globals || gen_random(8) == 0) return globals++;
+    return gen_random(globals);
+}
+
+static void gen_simple(unsigned indent) {
+    switch(gen_random(5)) {
+    case 0:
+        gen_line(indent, "x = x + y * %u - a;", gen_random(100));
+        break;
+
+    case 1:
+        gen_line(indent, "y = (y + %u) %% 97;", 1 + gen_random(50));
+        break;
+
+    case 2:
+        gen_line(indent, "g%lu = x;", gen_global());
+        break;
+
+    case 3:
+        if(functions) gen_line(indent, "x = f%u(x, y, %u);", gen_random(functions), gen_random(10));
+        else gen_line(indent, "x = -x;");
+        break;
+
+    default:
+        gen_line(indent, "b = \"s%u\";", gen_random(1000));
+        break;
+    }
+}
+
+static void gen_body(unsigned indent, unsigned depth) {
+    gen_simple(indent);
+
+    if(depth == 0) {
+        gen_simple(indent);
+        return;
+    }
+
+    switch(gen_random(3)) {
+    case 0:
+        gen_line(indent, "if (x > y and a != nil) {");
+        gen_body(indent + 1, depth - 1);
+        gen_line(indent, "} else {");
+        gen_simple(indent + 1);
+        gen_line(indent, "}");
+        break;
+
+    case 1:
+        gen_line(indent, "while (y > %u) {", gen_random(10));
+        gen_line(indent + 1, "y = y - 1;");
+        gen_body(indent + 1, depth - 1);
+        gen_line(indent, "}");
+        break;
+
+    default:
+        gen_line(indent, "for (local i%u = 0; i%u < %u; ++i%u) {", depth, depth, 1 + gen_random(8), depth);
+        gen_body(indent + 1, depth - 1);
+        gen_line(indent, "}");
+        break;
+    }
+}
+
+static void gen_function(void) {
+    gen_line(0, "function f%lu(a, b, c) {", functions);
+    gen_line(1, "local x = a + %lu;", functions);
+    gen_line(1, "local y = b * 2 - c;");
+    gen_body(1, 1 + gen_random(maxDepth));
+    gen_line(1, "return x + y;");
+    gen_line(0, "}");
+    gen_line(0, "");
+
+    ++functions;
+}
+
+static void gen_expression(void) {
+    static char *ops[] = { "+", "-", "*", "/", "%" };
+    static char *relops[] = { "<", ">", "<=", ">=", "==", "!=" };
+    unsigned long target = gen_global();
+
+    printf("g%lu = (g%lu", target, gen_global());
+
+    for(unsigned i = 1; i < exprTerms; ++i) {
+        if(i % 8 == 0) printf(") * (%u", 1 + gen_random(100));
+        else if(gen_random(2)) printf(" %s g%lu", ops[gen_random(5)], gen_global());
+        else printf(" %s %u", ops[gen_random(3)], 1 + gen_random(1000));
+    }
+
+    printf(");\n");
+    ++lines;
+
+    printf("if (g%lu %s %u", gen_global(), relops[gen_random(6)], gen_random(100));
+
+    for(unsigned i = 1; i < exprTerms / 4; ++i)
+        printf(" %s %sg%lu %s %u", gen_random(2) ? "and" : "or", gen_random(4) ? "" : "not ",
+               gen_global(), relops[gen_random(6)], gen_random(100));
+
+    printf(") {\n");
+    ++lines;
+
+    gen_line(1, "g%lu = true;", target);
+    gen_line(0, "}");
+}
+
+static void gen_table(void) {
+    unsigned entries = 1 + gen_random(tableEntries);
+
+    if(gen_random(2)) {
+        gen_line(0, "t%lu = [", tables);
+
+        for(unsigned i = 0; i < entries; ++i)
+            gen_line(1, "{\"k%u\" : %u}%s", i, gen_random(1000), i + 1 < entries ? "," : "");
+    }
+    else {
+        gen_line(0, "t%lu = [", tables);
+
+        for(unsigned i = 0; i < entries; ++i)
+            gen_line(1, "%u, %u.5, \"s%u\", %s%s", i, gen_random(100), i,
+                     gen_random(2) ? "true" : "nil", i + 1 < entries ? "," : "");
+    }
+
+    gen_line(0, "];");
+    ++tables;
+}
+
+static void gen_calls(void) {
+    if(!functions) return;
+
+    for(unsigned i = 0; i < 4; ++i)
+        gen_line(0, "g%lu = f%u(g%lu, %u, \"c%u\");", gen_global(), gen_random(functions),
+                 gen_global(), gen_random(100), i);
+
+    if(tables)
+        gen_line(0, "g%lu = t%u.k0;", gen_global(), gen_random(tables));
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long target = 0;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strncmp(argv[i], "--depth=", 8) == 0) maxDepth = atoi(argv[i] + 8);
+        else if(strncmp(argv[i], "--terms=", 8) == 0) exprTerms = atoi(argv[i] + 8);
+        else if(strncmp(argv[i], "--table=", 8) == 0) tableEntries = atoi(argv[i] + 8);
+        else if(strncmp(argv[i], "--seed=", 7) == 0) rngState += strtoull(argv[i] + 7, NULL, 10);
+        else if(argv[i][0] != '-') target = strtoul(argv[i], NULL, 10);
+        else target = 0, i = argc;
+    }
+
+    if(!target || !maxDepth || !exprTerms || !tableEntries) {
+        fprintf(stderr, "Usage: %s <lines> [--depth=N] [--terms=N] [--table=N] [--seed=N]\n", argv[0]);
+        return 1;
+    }
+
+    gen_line(0, "// Generated by gen_program: %lu lines requested", target);
+
+    while(lines < target) {
+        unsigned pick = gen_random(10);
+
+        if(pick < 5) gen_function();
+        else if(pick < 7) gen_expression();
+        else if(pick < 9) gen_table();
+        else gen_calls();
+    }
+
+    return 0;
+}
@@ -0,0 +1,385 @@
+/*
+ * table_bench - time avm_tables.c without the interpreter.
+ *
+ * For every key type (number, string, bool, table), key pattern
+ * (sequential, random, adversarial) and size, a fresh table gets n
+ * inserts, n lookup hits, n lookup misses, one iteration over all
+ * buckets and n deletes by nil assignment. Small sizes are repeated until
+ * at least BENCH_MIN_OPS operations were timed.
+ *
+ * Adversarial keys all land in bucket 0: multiples of the hash size for
+ * numbers and strings searched for a zero hash. Table keys hash by
+ * address, which the allocator decides, so they have no adversarial set.
+ * Bool keys only have two values; their n operations cycle over them.
+ *
+ * Tables use a fixed number of chains, so cost grows with n^2 once the
+ * chains get long. A size is skipped when the scaling measured on the
+ * smaller sizes predicts it would exceed the time budget, or when its keys
+ * and buckets would exceed the memory budget.
+ *
+ *   table_bench [--sizes=10,100,...] [--budget=seconds] [--max-mem=MB]
+ *               [--keys=number,string,bool,table]
+ *               [--patterns=sequential,random,adversarial]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "avm_tables.h"
+#include "avm_stats.h"
+
+#define BENCH_MIN_OPS 1000000UL
+#define BENCH_MAX_SIZES 16
+
+typedef enum bench_key { KEY_NUMBER, KEY_STRING, KEY_BOOL, KEY_TABLE, KEY_COUNT } bench_key;
+typedef enum bench_pattern { PATTERN_SEQUENTIAL, PATTERN_RANDOM, PATTERN_ADVERSARIAL, PATTERN_COUNT } bench_pattern;
+typedef enum bench_op { OP_INSERT, OP_HIT, OP_MISS, OP_ITERATE, OP_DELETE, OP_COUNT } bench_op;
+
+static char *keyNames[KEY_COUNT] = { "number", "string", "bool", "table" };
+static char *patternNames[PATTERN_COUNT] = { "sequential", "random", "adversarial" };
+static char *opNames[OP_COUNT] = { "insert", "lookup-hit", "lookup-miss", "iterate", "delete-nil" };
+
+/* Keys for one run: the first n are inserted, the next n are misses */
+typedef struct bench_keys {
+    avm_memcell *cells;
+    unsigned long distinct;     /* inserted keys */
+    unsigned long misses;       /* 0 when the key type has none */
+} bench_keys;
+
+typedef struct bench_cell {
+    double ns[OP_COUNT];
+    double bytesPerEntry;
+    unsigned long entries;
+} bench_cell;
+
+static unsigned long long rngState = 0x9e3779b97f4a7c15ULL;
+
+static unsigned long long bench_random(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_shuffle(avm_memcell *cells, unsigned long n) {
+    for(unsigned long i = n; i > 1; --i) {
+        unsigned long j = bench_random() % i;
+        avm_memcell tmp = cells[i - 1];
+        cells[i - 1] = cells[j];
+        cells[j] = tmp;
+    }
+}
+
+static char *bench_string(char *prefix, unsigned long long value) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%s%llx", prefix, value);
+    return strdup(buffer);
+}
+
+/* Candidate strings are tried in order; keep the ones that hash to 0 */
+static char *bench_collidingstring(unsigned long long *next) {
+    char buffer[64];
+
+    for(;;) {
+        snprintf(buffer, sizeof(buffer), "c%llx", (*next)++);
+
+        if(avm_hash_string(buffer) == 0)
+            return strdup(buffer);
+    }
+}
+
+static int bench_makekeys(bench_key key, bench_pattern pattern, unsigned long n, bench_keys *k) {
+    unsigned long total = key == KEY_BOOL ? 2 : 2 * n;
+    unsigned long long next = 0;
+
+    if(key == KEY_BOOL && pattern != PATTERN_SEQUENTIAL) return 0;
+    if(key == KEY_TABLE && pattern == PATTERN_ADVERSARIAL) return 0;
+
+    k->cells = (avm_memcell *)calloc(total, sizeof(avm_memcell));
+    k->distinct = key == KEY_BOOL ? 2 : n;
+    k->misses = key == KEY_BOOL ? 0 : n;
+
+    for(unsigned long i = 0; i < total; ++i) {
+        avm_memcell *m = &k->cells[i];
+
+        switch(key) {
+        case KEY_NUMBER:
+            m->type = number_m;
+
+            if(pattern == PATTERN_SEQUENTIAL) m->data.numVal = i;
+            else if(pattern == PATTERN_RANDOM) m->data.numVal = (double)(bench_random() >> 12) + i;
+            else m->data.numVal = (double)i * AVM_TABLE_HASHSIZE;
+
+            break;
+
+        case KEY_STRING:
+            m->type = string_m;
+
+            if(pattern == PATTERN_SEQUENTIAL) m->data.strVal = bench_string("key", i);
+            else if(pattern == PATTERN_RANDOM) m->data.strVal = bench_string("r", (bench_random() << 20) + i);
+            else m->data.strVal = bench_collidingstring(&next);
+
+            break;
+
+        case KEY_BOOL:
+            m->type = bool_m;
+            m->data.boolVal = i & 1;
+            break;
+
+        case KEY_TABLE:
+            m->type = table_m;
+            m->data.tableVal = avm_tablenew();
+            avm_tableincrefcounter(m->data.tableVal);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    /* Random order for table keys: allocation order is the sequential one */
+    if(key == KEY_TABLE && pattern == PATTERN_RANDOM)
+        bench_shuffle(k->cells, total);
+
+    return 1;
+}
+
+static void bench_freekeys(bench_keys *k) {
+    unsigned long total = k->distinct + k->misses;
+
+    for(unsigned long i = 0; i < total; ++i) {
+        if(k->cells[i].type == string_m) free(k->cells[i].data.strVal);
+        else if(k->cells[i].type == table_m) avm_tabledecrefcounter(k->cells[i].data.tableVal);
+    }
+
+    free(k->cells);
+}
+
+/* Walk every chain the way the library functions do */
+static unsigned long bench_iterate(avm_table *t) {
+    unsigned long visited = 0;
+
+    for(unsigned i = 0; i < AVM_TABLE_HASHSIZE; ++i) {
+        for(avm_table_bucket *b = t->numIndexed[i]; b; b = b->next)
+            visited += b->value.type == number_m;
+
+        for(avm_table_bucket *b = t->strIndexed[i]; b; b = b->next)
+            visited += b->value.type == number_m;
+    }
+
+    return visited;
+}
+
+/* Times one pass of every operation and adds it to cell; returns seconds */
+static double bench_pass(bench_keys *k, unsigned long n, bench_cell *cell) {
+    avm_memcell value, nil;
+    avm_memcell *keys = k->cells;
+    avm_memcell *misses = k->cells + k->distinct;
+    unsigned long found = 0;
+    double start, elapsed, total = 0;
+
+    value.type = number_m;
+    value.data.numVal = 1;
+    nil.type = nil_m;
+
+    avm_table *t = avm_tablenew();
+    avm_tableincrefcounter(t);
+
+    unsigned long before = memstats.heapBytes;
+
+    start = bench_now();
+    for(unsigned long i = 0; i < n; ++i)
+        avm_tablesetelem(t, &keys[i % k->distinct], &value);
+    elapsed = bench_now() - start;
+    cell->ns[OP_INSERT] += elapsed * 1e9 / n;
+    total += elapsed;
+
+    cell->entries = t->total;
+    cell->bytesPerEntry = (double)(memstats.heapBytes - before) / t->total;
+
+    start = bench_now();
+    for(unsigned long i = 0; i < n; ++i)
+        found += avm_tablegetelem(t, &keys[i % k->distinct]) != NULL;
+    elapsed = bench_now() - start;
+    cell->ns[OP_HIT] += elapsed * 1e9 / n;
+    total += elapsed;
+
+    if(k->misses) {
+        start = bench_now();
+        for(unsigned long i = 0; i < n; ++i)
+            found += avm_tablegetelem(t, &misses[i]) != NULL;
+        elapsed = bench_now() - start;
+        cell->ns[OP_MISS] += elapsed * 1e9 / n;
+        total += elapsed;
+    }
+
+    start = bench_now();
+    found += bench_iterate(t);
+    elapsed = bench_now() - start;
+    cell->ns[OP_ITERATE] += elapsed * 1e9 / t->total;
+    total += elapsed;
+
+    start = bench_now();
+    for(unsigned long i = 0; i < n; ++i)
+        avm_tablesetelem(t, &keys[i % k->distinct], &nil);
+    elapsed = bench_now() - start;
+    cell->ns[OP_DELETE] += elapsed * 1e9 / n;
+    total += elapsed;
+
+    if(found < n || t->total != 0)
+        fprintf(stderr, "warning: table lost entries (%lu found, %u left)\n", found, t->total);
+
+    avm_tabledecrefcounter(t);
+    return total;
+}
+
+/* Bytes a run needs up front: keys, their buckets and table keys */
+static double bench_memory(bench_key key, unsigned long n) {
+    double perKey = sizeof(avm_table_bucket);
+
+    if(key == KEY_STRING) perKey += 2 * 24;
+    if(key == KEY_TABLE) perKey += 2 * sizeof(avm_table);
+    if(key == KEY_BOOL) return 0;
+
+    return perKey * n + 2 * n * sizeof(avm_memcell);
+}
+
+static void bench_print(bench_key key, bench_pattern pattern, unsigned long n, bench_cell *cell, int hasMisses) {
+    for(int op = 0; op < OP_COUNT; ++op) {
+        printf("%-12s %-7s %-12s %10lu %10lu ", opNames[op], keyNames[key], patternNames[pattern],
+               n, cell->entries);
+
+        if(op == OP_MISS && !hasMisses) printf("%12s %12s\n", "-", "-");
+        else if(op == OP_INSERT) printf("%12.1f %12.1f\n", cell->ns[op], cell->bytesPerEntry);
+        else printf("%12.1f %12s\n", cell->ns[op], "");
+    }
+}
+
+static void bench_skipped(bench_key key, bench_pattern pattern, unsigned long n, char *why) {
+    printf("%-12s %-7s %-12s %10lu %10s %12s  skipped (%s)\n", "*", keyNames[key],
+           patternNames[pattern], n, "-", "-", why);
+}
+
+static int bench_enabled(char *list, char *name) {
+    if(!list) return 1;
+
+    size_t len = strlen(name);
+
+    for(char *p = strstr(list, name); p; p = strstr(p + 1, name))
+        if((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+            return 1;
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long sizes[BENCH_MAX_SIZES] = { 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+    unsigned nsizes = 7;
+    double budget = 2.0;
+    double maxMemory = 1024.0 * 1024 * 1024;
+    char *keyList = NULL, *patternList = NULL;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strncmp(argv[i], "--sizes=", 8) == 0) {
+            nsizes = 0;
+
+            for(char *p = argv[i] + 8; *p && nsizes < BENCH_MAX_SIZES; ) {
+                sizes[nsizes++] = strtoul(p, &p, 10);
+                if(*p == ',') ++p;
+            }
+        }
+        else if(strncmp(argv[i], "--budget=", 9) == 0)
+            budget = atof(argv[i] + 9);
+        else if(strncmp(argv[i], "--max-mem=", 10) == 0)
+            maxMemory = atof(argv[i] + 10) * 1024 * 1024;
+        else if(strncmp(argv[i], "--keys=", 7) == 0)
+            keyList = argv[i] + 7;
+        else if(strncmp(argv[i], "--patterns=", 11) == 0)
+            patternList = argv[i] + 11;
+        else {
+            fprintf(stderr, "Usage: %s [--sizes=10,100,...] [--budget=seconds] [--max-mem=MB] "
+                    "[--keys=number,string,bool,table] "
+                    "[--patterns=sequential,random,adversarial]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("%-12s %-7s %-12s %10s %10s %12s %12s\n",
+           "operation", "key", "pattern", "size", "entries", "ns/op", "bytes/entry");
+
+    for(int key = 0; key < KEY_COUNT; ++key) {
+        if(!bench_enabled(keyList, keyNames[key])) continue;
+
+        for(int pattern = 0; pattern < PATTERN_COUNT; ++pattern) {
+            if(!bench_enabled(patternList, patternNames[pattern])) continue;
+
+            double lastTime = 0, lastSize = 0, exponent = 2;
+
+            for(unsigned s = 0; s < nsizes; ++s) {
+                unsigned long n = sizes[s];
+                bench_keys k;
+                bench_cell cell;
+
+                if(!n) continue;
+
+                /* One pass at this size, scaled from the previous one */
+                if(lastTime > 0 && lastTime * pow(n / lastSize, exponent) > budget) {
+                    bench_skipped(key, pattern, n, "time budget");
+                    continue;
+                }
+
+                if(bench_memory(key, n) > maxMemory) {
+                    bench_skipped(key, pattern, n, "memory budget");
+                    continue;
+                }
+
+                if(!bench_makekeys(key, pattern, n, &k)) {
+                    printf("%-12s %-7s %-12s %10s %10s %12s  not applicable\n", "*",
+                           keyNames[key], patternNames[pattern], "-", "-", "-");
+                    break;
+                }
+
+                unsigned long reps = n >= BENCH_MIN_OPS ? 1 : BENCH_MIN_OPS / n;
+                double elapsed = 0;
+                unsigned long done = 0;
+
+                memset(&cell, 0, sizeof(cell));
+
+                while(done < reps && (done == 0 || elapsed < budget)) {
+                    elapsed += bench_pass(&k, n, &cell);
+                    ++done;
+                }
+
+                for(int op = 0; op < OP_COUNT; ++op)
+                    cell.ns[op] /= done;
+
+                bench_print(key, pattern, n, &cell, k.misses != 0);
+                bench_freekeys(&k);
+
+                /* Per-pass growth seen so far, between linear and quadratic */
+                double passTime = elapsed / done;
+
+                if(lastTime > 0 && passTime > 1e-3) {
+                    exponent = log(passTime / lastTime) / log(n / lastSize);
+                    if(exponent < 1) exponent = 1;
+                    if(exponent > 2) exponent = 2;
+                }
+
+                lastTime = passTime;
+                lastSize = n;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -1,4 +1,9 @@
 #include "alpha_vm_src/headers/avm.h"
+#include "alpha_vm_src/headers/avm_stats.h"
+#include "alpha_vm_src/headers/avm_heapdump.h"
+#include "alpha_vm_src/headers/avm_metrics.h"
+#include "alpha_vm_src/headers/avm_trace.h"
+#include "alpha_vm_src/headers/avm_coverage.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,6 +14,13 @@ void print_version(void);
 int main(int argc, char *argv[]) {
     char *filename = NULL;
     int debug_mode = 0;
+    int memstats_mode = 0;
+    char *heapdump_file = NULL;
+    char *metrics_file = NULL;
+    unsigned trace_instrs = 0;
+    unsigned trace_calls = 64;
+    char *coverage_file = NULL;
+    char *statsjson_file = NULL;
     int i;
     
     for(i = 1; i < argc; i++) {
@@ -23,6 +35,27 @@ int main(int argc, char *argv[]) {
         else if(strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--debug") == 0) {
             debug_mode = 1;
         }
+        else if(strcmp(argv[i], "--mem-stats") == 0) {
+            memstats_mode = 1;
+        }
+        else if(strncmp(argv[i], "--heap-dump-on-exit=", 20) == 0) {
+            heapdump_file = argv[i] + 20;
+        }
+        else if(strncmp(argv[i], "--metrics-file=", 15) == 0) {
+            metrics_file = argv[i] + 15;
+        }
+        else if(strncmp(argv[i], "--coverage=", 11) == 0) {
+            coverage_file = argv[i] + 11;
+        }
+        else if(strncmp(argv[i], "--stats-json=", 13) == 0) {
+            statsjson_file = argv[i] + 13;
+        }
+        else if(strncmp(argv[i], "--trace=", 8) == 0) {
+            if(sscanf(argv[i] + 8, "%u,%u", &trace_instrs, &trace_calls) < 1 || !trace_instrs) {
+                fprintf(stderr, "Error: Invalid trace size '%s'\n", argv[i] + 8);
+                return 1;
+            }
+        }
         else if(argv[i][0] != '-') {
             if(filename != NULL) {
                 fprintf(stderr, "Error: Multiple input files specified\n");
@@ -65,6 +98,13 @@ int main(int argc, char *argv[]) {
     }
     
     avm_initialize();
+    avm_metrics_install(metrics_file);
+
+    if(trace_instrs)
+        avm_trace_initialize(trace_instrs, trace_calls);
+
+    if(coverage_file)
+        avm_coverage_enable(coverage_file);
     
     if(debug_mode) {
         printf("VM initialized successfully\n");
@@ -74,6 +114,28 @@ int main(int argc, char *argv[]) {
     
     avm_run(filename);
     
+    if(memstats_mode) {
+        fflush(stdout);
+        avm_memstats_print(stderr);
+    }
+
+    if(heapdump_file)
+        avm_heapdump(heapdump_file);
+
+    if(statsjson_file) {
+        FILE *out = fopen(statsjson_file, "w");
+
+        if(out) {
+            avm_metrics_dump(out);
+            fclose(out);
+        }
+        else
+            fprintf(stderr, "Error: Cannot write stats to '%s'\n", statsjson_file);
+    }
+
+    if(coverage_file)
+        avm_coverage_write(filename);
+
     if(debug_mode) {
         printf("========================================\n");
         printf("Program execution completed\n");
@@ -81,6 +143,8 @@ int main(int argc, char *argv[]) {
     }
     
     avm_cleanup();
+    avm_trace_cleanup();
+    avm_coverage_cleanup();
     
     if(debug_mode) {
         printf("VM cleanup completed\n");
@@ -103,6 +167,18 @@ void print_usage(char *program_name) {
     printf("  -h, --help     Show this help message\n");
     printf("  -v, --version  Show version information\n");
     printf("  -d, --debug    Enable debug output\n");
+    printf("  --mem-stats    Print heap counters to stderr when the program ends\n");
+    printf("  --heap-dump-on-exit=<file>\n");
+    printf("                 Write a heap dump when the program ends (see avm_heapsummary)\n");
+    printf("  --metrics-file=<file>\n");
+    printf("                 Append SIGUSR1 snapshots to <file> instead of stderr\n");
+    printf("  --stats-json=<file>\n");
+    printf("                 Write the final instruction and heap counters to <file> as JSON\n");
+    printf("  --trace=<n>[,<m>]\n");
+    printf("                 Keep the last n instructions and m calls (default 64), dumped\n");
+    printf("                 on runtime errors, assertion failures and by tracedump()\n");
+    printf("  --coverage=<file>\n");
+    printf("                 Write lcov line/branch coverage, adding to an existing <file>\n");
     printf("\nExample:\n");
     printf("  %s program.abc\n", program_name);
     printf("\nThe binary file must have been generated by the Alpha compiler.\n");